@@ -0,0 +1,433 @@
+#include "adjacency_f.h"
+#include "province_map_f.h"
+#include "permutation_f.h"
+#include "perceptual_f.h"
+#include "stats_f.h"
+#include <limits>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const size_t BORDER_BUFFER_PAIRS = 1 << 22;		// Border pairs collected before the buffer is compacted.
+static const size_t CANDIDATES_PER_PROVINCE = 16;
+static const size_t POOL_LIMIT = 1 << 21;
+
+/*Run body(begin, end) over [0, count) split into one contiguous range per thread.*/
+
+template <class Body>
+static void parallelFor(size_t count, unsigned int threads, Body body) {
+
+	if (threads <= 1 || count < 2 * (size_t)threads) {
+		body((size_t)0, count);
+		return;
+	}
+
+	std::vector<std::thread> pool;
+
+	for (unsigned int i = 1; i < threads; i++)
+		pool.push_back(std::thread(body, count * i / threads, count * (i + 1) / threads));
+
+	body((size_t)0, count / threads);
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+}
+
+size_t ProvinceGraph::indexOf(Color color) const {
+
+	ColorList::const_iterator found = std::lower_bound(colors.begin(), colors.end(), color);
+
+	return found != colors.end() && *found == color ? found - colors.begin() : colors.size();
+
+}
+
+/*A border between two colors, smaller color in the high bits so sorted pairs group by their first vertex.*/
+
+static inline uint64_t borderKey(Color a, Color b) {
+	return a < b ? ((uint64_t)a << 24) | b : ((uint64_t)b << 24) | a;
+}
+
+/*Along a border the same pair repeats pixel after pixel; a pair equal to the last one added is dropped straight away.*/
+
+static inline void addBorder(std::vector<uint64_t> &borders, Color a, Color b) {
+
+	uint64_t key = borderKey(a, b);
+
+	if (borders.empty() || key != borders.back())
+		borders.push_back(key);
+
+}
+
+static void compactBorders(std::vector<uint64_t> &borders) {
+	std::sort(borders.begin(), borders.end());
+	borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+}
+
+ProvinceGraph buildProvinceGraph(const std::string &path) {
+
+	ProvinceGraph graph;
+	ProvinceMapReader reader(path);
+	ColorBitmap present;
+	std::vector<uint64_t> borders;
+	ColorList previousRow;
+	size_t limit = BORDER_BUFFER_PAIRS;
+
+	graph.width = reader.width();
+	graph.height = reader.height();
+
+	{
+		StageTimer stage("read borders");
+
+		for (const Color *row; (row = reader.nextRow()) != NULL; ) {
+
+			for (int x = 0; x < graph.width; x++) {
+
+				Color color = row[x];
+
+				if (x == 0 || color != row[x - 1]) {
+					present.set(color);
+					if (x > 0)
+						addBorder(borders, color, row[x - 1]);
+				}
+
+				if (!previousRow.empty() && color != previousRow[x])
+					addBorder(borders, color, previousRow[x]);
+
+			}
+
+			if (borders.size() >= limit) {
+				compactBorders(borders);
+				limit = std::max(limit, 2 * borders.size());
+			}
+
+			previousRow.assign(row, row + graph.width);
+
+		}
+
+		compactBorders(borders);
+	}
+
+	StageTimer stage("build graph");
+
+	for (size_t w = 0; w < present.words.size(); w++) {
+		for (uint64_t bits = present.words[w]; bits != 0; bits &= bits - 1)
+			graph.colors.push_back((Color)(w * 64 + lowestBit64(bits)));
+	}
+
+	/* Vertex numbers by rank in the bitmap: a prefix count per word plus a popcount within it. */
+
+	std::vector<uint32_t> rank(present.words.size() + 1, 0);
+
+	for (size_t w = 0; w < present.words.size(); w++)
+		rank[w + 1] = rank[w] + popCount64(present.words[w]);
+
+	auto vertexOf = [&](Color color) {
+		return rank[color >> 6] + (uint32_t)popCount64(present.words[color >> 6] & (((uint64_t)1 << (color & 63)) - 1));
+	};
+
+	graph.offsets.assign(graph.colors.size() + 1, 0);
+
+	for (uint64_t key : borders) {
+		graph.offsets[vertexOf((Color)(key >> 24)) + 1]++;
+		graph.offsets[vertexOf((Color)(key & 0xffffff)) + 1]++;
+	}
+
+	for (size_t v = 0; v < graph.colors.size(); v++)
+		graph.offsets[v + 1] += graph.offsets[v];
+
+	/* Pairs are sorted by first vertex, so every list fills in increasing order: lower neighbours first, then higher ones. */
+
+	std::vector<uint32_t> fill(graph.offsets.begin(), graph.offsets.end() - 1);
+	graph.neighbours.resize(graph.offsets.back());
+
+	for (uint64_t key : borders) {
+		uint32_t a = vertexOf((Color)(key >> 24));
+		uint32_t b = vertexOf((Color)(key & 0xffffff));
+		graph.neighbours[fill[a]++] = b;
+		graph.neighbours[fill[b]++] = a;
+	}
+
+	return graph;
+
+}
+
+/*SplitMix64 finalizer, used for vertex priorities.*/
+
+static uint64_t mix64(uint64_t z) {
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+
+}
+
+static float labDistanceSquared(const LabColor &first, const LabColor &second) {
+
+	float dL = first.L - second.L;
+	float da = first.a - second.a;
+	float db = first.b - second.b;
+
+	return dL * dL + da * da + db * db;
+
+}
+
+/*
+	Jones-Plassmann coloring of the vertices whose class is -1. Every round, each of them whose priority beats all its uncolored neighbours
+	takes the smallest class none of its neighbours has. Those vertices are never adjacent, so a round colors them all in parallel without locks,
+	and the result depends only on the priorities, not on the threads. Returns the number of classes.
+*/
+
+static int classifyProvinces(const ProvinceGraph &graph, std::vector<uint32_t> remaining, std::vector<int> &classOf, uint64_t seed, unsigned int threads) {
+
+	std::vector<uint64_t> priority(graph.colors.size());
+	std::vector<char> chosen;
+
+	for (size_t v = 0; v < priority.size(); v++)
+		priority[v] = mix64(seed + 0x9e3779b97f4a7c15ULL * (v + 1));
+
+	auto beats = [&](uint32_t u, uint32_t v) {
+		return priority[u] > priority[v] || (priority[u] == priority[v] && u > v);
+	};
+
+	while (!remaining.empty()) {
+
+		chosen.assign(remaining.size(), 0);
+
+		parallelFor(remaining.size(), threads, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				uint32_t v = remaining[i];
+				bool top = true;
+				for (uint32_t k = graph.offsets[v]; k < graph.offsets[v + 1] && top; k++) {
+					uint32_t u = graph.neighbours[k];
+					top = classOf[u] != -1 || beats(v, u);
+				}
+				chosen[i] = top;
+			}
+		});
+
+		parallelFor(remaining.size(), threads, [&](size_t begin, size_t end) {
+			std::vector<int> taken;
+			for (size_t i = begin; i < end; i++) {
+				if (!chosen[i])
+					continue;
+				uint32_t v = remaining[i];
+				taken.clear();
+				for (uint32_t k = graph.offsets[v]; k < graph.offsets[v + 1]; k++) {
+					if (classOf[graph.neighbours[k]] >= 0)
+						taken.push_back(classOf[graph.neighbours[k]]);
+				}
+				std::sort(taken.begin(), taken.end());
+				int free = 0;
+				for (size_t t = 0; t < taken.size() && taken[t] <= free; t++)
+					free = std::max(free, taken[t] + 1);
+				classOf[v] = free;
+			}
+		});
+
+		size_t kept = 0;
+
+		for (size_t i = 0; i < remaining.size(); i++) {
+			if (!chosen[i])
+				remaining[kept++] = remaining[i];
+		}
+
+		remaining.resize(kept);
+
+	}
+
+	int classes = 0;
+
+	for (int c : classOf)
+		classes = std::max(classes, c + 1);
+
+	return classes;
+
+}
+
+ProvinceColoring colorProvinces(const ProvinceGraph &graph, const ColorBitmap &fixed, const ColorBitmap &reserved, const short *clampVals, uint64_t seed, unsigned int threads) {
+
+	ProvinceColoring coloring;
+	size_t vertexCount = graph.colors.size();
+	std::vector<int> classOf(vertexCount, -2);
+
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	coloring.colors = graph.colors;
+
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		if (!fixed.test(graph.colors[v])) {
+			coloring.recolored.push_back(v);
+			classOf[v] = -1;
+		}
+	}
+
+	size_t count = coloring.recolored.size();
+
+	if (count == 0)
+		return coloring;
+
+	{
+		StageTimer stage("classify");
+		coloring.classes = classifyProvinces(graph, coloring.recolored, classOf, seed, threads);
+	}
+
+	/* Pool: a slice of candidates per province, taken from the free colors in seeded order so every slice is spread over the space. */
+
+	StageTimer stage("assign colors");
+	short clamp[6];
+	std::copy(clampVals, clampVals + 6, clamp);
+	unsigned long available = countFreeColors(reserved, clamp);
+
+	if (available < count)
+		throw std::runtime_error("Could not color the provinces. " + std::to_string(count) + " need new colors, but only " + std::to_string(available) + " unreserved colors exist in the clamped range.");
+
+	size_t perProvince = std::max<size_t>(1, std::min<size_t>(CANDIDATES_PER_PROVINCE, std::min<size_t>(available, POOL_LIMIT) / count));
+	ColorList pool(count * perProvince);
+	std::vector<LabColor> poolLab(pool.size());
+	PermutedColorStream stream(reserved, clamp, seed);
+
+	stream.next(pool.data(), pool.size());
+
+	/* Counters: the pool scan, with the candidates no province took as surplus. */
+
+	GenerationCounters counters = stream.counters();
+	counters.accepted = count;
+	counters.surplus = pool.size() - count;
+	recordCounters(counters);
+
+	parallelFor(pool.size(), threads, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			poolLab[i] = toLab(pool[i]);
+	});
+
+	/* One anchor per class, each the pool color farthest from the anchors before it. */
+
+	int classes = coloring.classes;
+	std::vector<size_t> anchors(1, 0);
+	std::vector<float> nearest(pool.size(), std::numeric_limits<float>::max());
+
+	while ((int)anchors.size() < classes) {
+
+		const LabColor &newest = poolLab[anchors.back()];
+
+		parallelFor(pool.size(), threads, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				nearest[i] = std::min(nearest[i], labDistanceSquared(poolLab[i], newest));
+		});
+
+		anchors.push_back(std::max_element(nearest.begin(), nearest.end()) - nearest.begin());
+
+	}
+
+	/* Cells: each pool color joins the nearest anchor whose class still needs candidates. Capacities add up to the pool, so every cell fills. */
+
+	std::vector<std::vector<uint32_t>> members(classes);
+	std::vector<std::vector<uint32_t>> cells(classes);
+
+	for (uint32_t v : coloring.recolored)
+		members[classOf[v]].push_back(v);
+
+	for (size_t i = 0; i < pool.size(); i++) {
+		int best = -1;
+		float bestDistance = 0;
+		for (int c = 0; c < classes; c++) {
+			if (cells[c].size() == members[c].size() * perProvince)
+				continue;
+			float distance = labDistanceSquared(poolLab[i], poolLab[anchors[c]]);
+			if (best < 0 || distance < bestDistance) {
+				best = c;
+				bestDistance = distance;
+			}
+		}
+		cells[best].push_back((uint32_t)i);
+	}
+
+	/* Color class by class. Within a class no two provinces touch, so each only reads neighbours colored in earlier classes or fixed. */
+
+	std::vector<LabColor> lab(vertexCount);
+
+	parallelFor(vertexCount, threads, [&](size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++) {
+			if (classOf[v] == -2)
+				lab[v] = toLab(graph.colors[v]);
+		}
+	});
+
+	for (int c = 0; c < classes; c++) {
+
+		parallelFor(members[c].size(), threads, [&](size_t begin, size_t end) {
+			for (size_t j = begin; j < end; j++) {
+
+				uint32_t v = members[c][j];
+				const uint32_t *slice = cells[c].data() + j * perProvince;
+				size_t best = slice[0];
+				float bestScore = -1;
+
+				for (size_t k = 0; k < perProvince; k++) {
+					float score = std::numeric_limits<float>::max();
+					for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++) {
+						uint32_t u = graph.neighbours[e];
+						if (classOf[u] < c)
+							score = std::min(score, labDistanceSquared(poolLab[slice[k]], lab[u]));
+					}
+					if (score > bestScore) {
+						best = slice[k];
+						bestScore = score;
+					}
+				}
+
+				coloring.colors[v] = pool[best];
+				lab[v] = poolLab[best];
+
+			}
+		});
+
+	}
+
+	/* Neighbour distances over every border that involves a recolored province. */
+
+	double total = 0;
+	size_t borders = 0;
+	coloring.minNeighbourDeltaE = std::numeric_limits<double>::max();
+
+	for (uint32_t v = 0; v < vertexCount; v++) {
+		for (uint32_t e = graph.offsets[v]; e < graph.offsets[v + 1]; e++) {
+			uint32_t u = graph.neighbours[e];
+			if (u > v && (classOf[u] >= 0 || classOf[v] >= 0)) {
+				double distance = deltaE(lab[u], lab[v]);
+				coloring.minNeighbourDeltaE = std::min(coloring.minNeighbourDeltaE, distance);
+				total += distance;
+				borders++;
+			}
+		}
+	}
+
+	coloring.meanNeighbourDeltaE = borders > 0 ? total / borders : 0;
+
+	if (borders == 0)
+		coloring.minNeighbourDeltaE = 0;
+
+	return coloring;
+
+}
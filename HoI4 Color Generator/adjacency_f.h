@@ -0,0 +1,63 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ProvinceGraph is the adjacency graph of a provinces.bmp: one vertex per color in the map, numbered in packed order,
+and an edge wherever two colors touch horizontally or vertically. Vertex v's neighbours are neighbours[offsets[v]] up to neighbours[offsets[v + 1]], sorted.
+
+buildProvinceGraph reads the map once through ProvinceMapReader, comparing each pixel with its left and upper neighbours.
+Border pairs collect in a buffer that is sorted and deduplicated whenever it fills, so memory follows the number of borders, not pixels.
+
+colorProvinces gives a fresh color to every province whose color is not in fixed, keeping neighbours far apart in CIELAB:
+	1. The provinces to color are split into classes no two neighbours share, by parallel Jones-Plassmann coloring (maps need about six).
+	2. A pool of free colors (outside reserved, inside clampVals, in ColorPermutation order for seed) is split into one CIELAB cell per class
+	   around farthest-point anchors, so neighbours, being in different classes, draw from distant parts of the color space.
+	3. Classes are colored in turn. The provinces of one class never touch, so they are colored in parallel: each takes, from its own slice of
+	   its class's cell, the candidate with the largest minimum delta E to its fixed and already-colored neighbours.
+The result is the same for any thread count. Throws std::runtime_error if reserved leaves fewer free colors than there are provinces to color.
+*/
+
+struct ProvinceGraph {
+	ColorList colors;
+	std::vector<uint32_t> offsets;
+	std::vector<uint32_t> neighbours;
+	int width = 0;
+	int height = 0;
+
+	size_t indexOf(Color color) const;			// colors.size() if the color is not in the map.
+	size_t edgeCount() const { return neighbours.size() / 2; }
+};
+
+struct ProvinceColoring {
+	ColorList colors;							// The color of every vertex: new for recolored ones, unchanged for fixed ones.
+	std::vector<uint32_t> recolored;			// Vertices that got a new color, in vertex order.
+	int classes = 0;
+	double minNeighbourDeltaE = 0;				// Over edges with at least one recolored end.
+	double meanNeighbourDeltaE = 0;
+};
+
+ProvinceGraph buildProvinceGraph(const std::string &path);
+
+ProvinceColoring colorProvinces(const ProvinceGraph &graph, const ColorBitmap &fixed, const ColorBitmap &reserved, const short *clampVals, uint64_t seed, unsigned int threads = 0);
@@ -0,0 +1,157 @@
+#include "allocator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+ColorAllocator::ColorAllocator(const ColorBitmap &reserved, const short *clampVals) : words(new std::atomic<uint64_t>[WORD_COUNT]) {
+
+	static const short FULL_CLAMP[6] = { 0, 0, 0, 255, 255, 255 };
+	uint64_t mask[4];
+
+	if (clampVals == NULL)
+		clampVals = FULL_CLAMP;
+
+	for (size_t w = 0; w < WORD_COUNT; w++)
+		words[w].store(~(uint64_t)0, std::memory_order_relaxed);
+
+	for (int r = clampVals[0]; r <= clampVals[3]; r++) {
+		for (int g = clampVals[1]; g <= clampVals[4]; g++) {
+			size_t base = ((size_t)r << 10) | ((size_t)g << 2);
+			freeRowMask(reserved, r, g, clampVals, mask);
+			for (int w = 0; w < 4; w++)
+				words[base + w].store(~mask[w], std::memory_order_relaxed);
+		}
+	}
+
+	for (size_t w = 0; w < WORD_COUNT; w++)
+		fixed.words[w] = words[w].load(std::memory_order_relaxed);
+
+}
+
+/*Starting points are rounded down to 8 words (64 bytes), so neighbouring workers never begin in the same cache line.*/
+
+ColorAllocator::Cursor ColorAllocator::cursor(unsigned int worker, unsigned int workers) const {
+
+	Cursor cursor;
+
+	if (workers > 1)
+		cursor.word = (size_t)((uint64_t)WORD_COUNT * (worker % workers) / workers) & ~(size_t)7;
+
+	return cursor;
+
+}
+
+/*
+	Scan words from the cursor, wrapping at the end of the cube, for at most one lap.
+	In each word with free bits, try to take as many of the lowest free bits as are still wanted with a single fetch-or.
+	Bits another thread set first are simply not ours; the word is retried with what remains.
+*/
+
+size_t ColorAllocator::allocate(Cursor &cursor, Color *out, size_t count) {
+
+	size_t taken = 0;
+	size_t w = cursor.word;
+
+	for (size_t scanned = 0; taken < count && scanned <= WORD_COUNT; ) {
+
+		uint64_t current = words[w].load(std::memory_order_relaxed);
+
+		while (~current != 0 && taken < count) {
+
+			uint64_t want = 0;
+			uint64_t free = ~current;
+
+			for (size_t i = taken; i < count && free != 0; i++) {
+				want |= free & (~free + 1);
+				free &= free - 1;
+			}
+
+			uint64_t before = words[w].fetch_or(want, std::memory_order_acq_rel);
+
+			for (uint64_t won = want & ~before; won != 0; won &= won - 1)
+				out[taken++] = (Color)(w * 64 + lowestBit64(won));
+
+			current = before | want;
+
+		}
+
+		if (taken == count)
+			break;
+
+		w = w + 1 == WORD_COUNT ? 0 : w + 1;
+		scanned++;
+
+	}
+
+	cursor.word = w;
+
+	return taken;
+
+}
+
+bool ColorAllocator::claim(Color color) {
+
+	uint64_t bit = (uint64_t)1 << (color & 63);
+
+	return (words[(color & 0xFFFFFF) >> 6].fetch_or(bit, std::memory_order_acq_rel) & bit) == 0;
+
+}
+
+void ColorAllocator::release(Color color) {
+
+	if (fixed.test(color & 0xFFFFFF))
+		return;
+
+	words[(color & 0xFFFFFF) >> 6].fetch_and(~((uint64_t)1 << (color & 63)), std::memory_order_acq_rel);
+
+}
+
+bool ColorAllocator::isTaken(Color color) const {
+
+	return ((words[(color & 0xFFFFFF) >> 6].load(std::memory_order_acquire) >> (color & 63)) & 1) != 0;
+
+}
+
+/*Free colors at the moment of the call. Other threads may change the count while it is taken.*/
+
+unsigned long ColorAllocator::available() const {
+
+	unsigned long total = 0;
+
+	for (size_t w = 0; w < WORD_COUNT; w++)
+		total += popCount64(~words[w].load(std::memory_order_relaxed));
+
+	return total;
+
+}
+
+/*Taken colors as a plain bitmap, for example to save with the reserved set. Colors outside the clamp box count as taken.*/
+
+ColorBitmap ColorAllocator::snapshot() const {
+
+	ColorBitmap taken;
+
+	for (size_t w = 0; w < WORD_COUNT; w++)
+		taken.words[w] = words[w].load(std::memory_order_acquire);
+
+	return taken;
+
+}
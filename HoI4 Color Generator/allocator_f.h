@@ -0,0 +1,74 @@
+#pragma once
+
+#include "generator_f.h"
+
+#include <atomic>
+#include <memory>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ColorAllocator hands out free colors to any number of threads at once without a lock. Every color is handed out at most once.
+
+Its state is the reserved bitmap held as atomic 64-bit words, with colors outside the clamp box marked taken from the start.
+A thread claims colors by fetch-or on a word: the bits it sets that were clear before are its colors, so two threads can never both win one.
+Each thread scans from its own Cursor. cursor(worker, workers) spreads the starting points evenly over the cube, so threads work in different cache lines
+until one runs out of colors ahead of it and continues into the next thread's region. A call that finds nothing after one lap over the cube returns 0.
+
+claim takes one specific color (for provinces drawn by hand) and reports whether this call took it. release returns a color; a cursor that has passed it
+finds it again on its next lap. Reserved colors and colors outside the clamp box stay taken: releasing one does nothing. Colors come out in a different order on each run when several threads allocate; use Generator for reproducible output.
+*/
+
+class ColorAllocator {
+
+public:
+
+	class Cursor {
+		friend class ColorAllocator;
+		size_t word = 0;
+	};
+
+	explicit ColorAllocator(const ColorBitmap &reserved, const short *clampVals = NULL);
+
+	ColorAllocator(const ColorAllocator &) = delete;
+	ColorAllocator &operator=(const ColorAllocator &) = delete;
+
+	Cursor cursor(unsigned int worker = 0, unsigned int workers = 1) const;
+
+	size_t allocate(Cursor &cursor, Color *out, size_t count);
+	bool allocate(Cursor &cursor, Color &color) { return allocate(cursor, &color, 1) == 1; }
+
+	bool claim(Color color);
+	void release(Color color);
+	bool isTaken(Color color) const;
+
+	unsigned long available() const;
+	ColorBitmap snapshot() const;
+
+private:
+
+	static const size_t WORD_COUNT = COLOR_SPACE_SIZE / 64;
+
+	std::unique_ptr<std::atomic<uint64_t>[]> words;
+	ColorBitmap fixed;			// Reserved or outside the clamp box; never freed.
+
+};
@@ -0,0 +1,372 @@
+#include "audit_f.h"
+#include "definition_f.h"
+#include "mapped_file_f.h"
+#include "stats_f.h"
+#include <unordered_set>
+#include <functional>
+#include <filesystem>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+unsigned long DefinitionAudit::missingIdCount() const {
+
+	unsigned long total = 0;
+
+	for (const std::pair<long, long> &range : missingIds)
+		total += range.second - range.first + 1;
+
+	return total;
+
+}
+
+bool DefinitionAudit::clean() const {
+	return malformed.empty() && badChannels.empty() && negativeIds.empty() && duplicateColors.empty() && duplicateIds.empty() && missingIds.empty();
+}
+
+/*Rows and problems of one chunk, with line numbers counted from the chunk's first line.*/
+
+struct AuditChunk {
+	unsigned long lines = 0;
+	std::vector<DefinitionRow> rows;
+	std::vector<DefinitionProblem> malformed;
+};
+
+/*Parse the lines from begin to end, the same way parseDefinitionText does, but record bad lines instead of throwing.*/
+
+static void auditChunk(const char *file, const char *begin, const char *end, bool firstChunk, AuditChunk &chunk) {
+
+	const char *cursor = begin;
+
+	while (cursor < end) {
+
+		const char *lineEnd = (const char *)memchr(cursor, '\n', end - cursor);
+		if (lineEnd == NULL)
+			lineEnd = end;
+
+		const char *line = cursor;
+		cursor = lineEnd < end ? lineEnd + 1 : end;
+		chunk.lines++;
+
+		if (lineEnd > line && lineEnd[-1] == '\r')
+			lineEnd--;
+
+		if (line == lineEnd || *line == '#')
+			continue;
+
+		long fields[4];
+		const char *error = parseDefinitionFields(line, lineEnd, fields, 4);
+
+		if (error != NULL) {
+			if (!(firstChunk && chunk.lines == 1 && (*line < '0' || *line > '9')))
+				chunk.malformed.push_back({ chunk.lines, std::string(error) + ": " + std::string(line, std::min(lineEnd, line + 60)) });
+			continue;
+		}
+
+		/* Fields are plain numbers, so the fourth ends at the fourth separator or at the end of the line. */
+
+		const char *fieldsEnd = line;
+		for (int separators = 0; fieldsEnd < lineEnd && (*fieldsEnd != ';' || ++separators < 4); fieldsEnd++);
+
+		DefinitionRow row;
+		row.line = chunk.lines;
+		row.provinceId = fields[0];
+		std::copy(fields + 1, fields + 4, row.channels);
+		row.begin = line - file;
+		row.fieldsEnd = fieldsEnd - file;
+		chunk.rows.push_back(row);
+
+	}
+
+}
+
+/*
+	Chunks are parsed in parallel and joined in order, then one pass over the rows in file order finds the duplicates:
+	the first row to use a color or ID keeps it, and every later one is reported. That pass touches one bitmap bit per row.
+*/
+
+DefinitionAudit auditDefinition(const std::string &csv, unsigned int threads) {
+
+	MappedFile definition(csv);
+	DefinitionAudit audit;
+	const char *begin = definition.begin();
+	const char *end = definition.end();
+
+	if (end - begin >= 3 && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+		begin += 3;
+
+	if (threads == 0)
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	/* Cut the file into one chunk per thread, each ending just after a newline. */
+
+	std::vector<const char *> cuts(1, begin);
+
+	for (unsigned int i = 1; i < threads; i++) {
+		const char *cut = std::max(begin + (end - begin) * i / threads, cuts.back());
+		const char *newline = (const char *)memchr(cut, '\n', end - cut);
+		cuts.push_back(newline == NULL ? end : newline + 1);
+	}
+
+	cuts.push_back(end);
+
+	std::vector<AuditChunk> chunks(threads);
+
+	{
+		StageTimer stage("parse");
+		std::vector<std::thread> pool;
+
+		for (unsigned int i = 1; i < threads; i++)
+			pool.push_back(std::thread(auditChunk, definition.begin(), cuts[i], cuts[i + 1], false, std::ref(chunks[i])));
+
+		auditChunk(definition.begin(), cuts[0], cuts[1], true, chunks[0]);
+
+		for (size_t i = 0; i < pool.size(); i++)
+			pool[i].join();
+	}
+
+	StageTimer stage("audit");
+
+	for (AuditChunk &chunk : chunks) {
+		for (DefinitionRow &row : chunk.rows) {
+			row.line += audit.lines;
+			audit.rows.push_back(row);
+		}
+		for (DefinitionProblem &problem : chunk.malformed) {
+			problem.line += audit.lines;
+			audit.malformed.push_back(problem);
+		}
+		audit.lines += chunk.lines;
+	}
+
+	/* IDs are usually dense, so a flag per ID is cheap; a file with huge IDs falls back to a hash set. */
+
+	long highestId = 0;
+
+	for (const DefinitionRow &row : audit.rows)
+		highestId = std::max(highestId, row.provinceId);
+
+	bool denseIds = highestId <= COLOR_SPACE_SIZE;
+	std::vector<bool> seenIds(denseIds ? highestId + 1 : 0, false);
+	std::unordered_set<long> sparseIds;
+
+	for (size_t i = 0; i < audit.rows.size(); i++) {
+
+		const DefinitionRow &row = audit.rows[i];
+		bool channelsValid = true;
+
+		for (int c = 0; c < 3; c++)
+			channelsValid = channelsValid && row.channels[c] >= 0 && row.channels[c] <= 255;
+
+		if (!channelsValid)
+			audit.badChannels.push_back(i);
+		else {
+			Color color = packColor((unsigned int)row.channels[0], (unsigned int)row.channels[1], (unsigned int)row.channels[2]);
+			if (audit.colors.test(color))
+				audit.duplicateColors.push_back(i);
+			else
+				audit.colors.set(color);
+		}
+
+		if (row.provinceId < 0) {
+			audit.negativeIds.push_back(i);
+			continue;
+		}
+
+		bool seen = denseIds ? seenIds[row.provinceId] : !sparseIds.insert(row.provinceId).second;
+
+		if (seen)
+			audit.duplicateIds.push_back(i);
+		else if (denseIds)
+			seenIds[row.provinceId] = true;
+
+	}
+
+	audit.maxProvinceId = highestId;
+
+	if (denseIds) {
+		for (long id = 1; id <= highestId; id++) {
+			if (seenIds[id])
+				continue;
+			long last = id;
+			while (last < highestId && !seenIds[last + 1])
+				last++;
+			audit.missingIds.push_back(std::make_pair(id, last));
+			id = last;
+		}
+	}
+	else {
+		std::vector<long> ids(sparseIds.begin(), sparseIds.end());
+		std::sort(ids.begin(), ids.end());
+		long expected = 1;
+		for (long id : ids) {
+			if (id > expected)
+				audit.missingIds.push_back(std::make_pair(expected, id - 1));
+			expected = std::max(expected, id + 1);
+		}
+	}
+
+	return audit;
+
+}
+
+/*One problem per line, in line order: "line N: description".*/
+
+void writeAuditReport(const std::string &path, const std::string &csv, const DefinitionAudit &audit) {
+
+	std::vector<DefinitionProblem> problems = audit.malformed;
+
+	auto rowProblem = [&](size_t index, const std::string &description) {
+		problems.push_back({ audit.rows[index].line, description });
+	};
+
+	for (size_t i : audit.badChannels) {
+		const DefinitionRow &row = audit.rows[i];
+		rowProblem(i, "color " + std::to_string(row.channels[0]) + ";" + std::to_string(row.channels[1]) + ";" + std::to_string(row.channels[2]) + " has a value outside 0-255");
+	}
+
+	for (size_t i : audit.negativeIds)
+		rowProblem(i, "negative province ID " + std::to_string(audit.rows[i].provinceId));
+
+	for (size_t i : audit.duplicateColors) {
+		const DefinitionRow &row = audit.rows[i];
+		rowProblem(i, "color " + std::to_string(row.channels[0]) + ";" + std::to_string(row.channels[1]) + ";" + std::to_string(row.channels[2]) + " is already used by an earlier row");
+	}
+
+	for (size_t i : audit.duplicateIds)
+		rowProblem(i, "province ID " + std::to_string(audit.rows[i].provinceId) + " is already used by an earlier row");
+
+	std::stable_sort(problems.begin(), problems.end(), [](const DefinitionProblem &a, const DefinitionProblem &b) { return a.line < b.line; });
+
+	std::ofstream out(path);
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+	for (const DefinitionProblem &problem : problems)
+		out << csv << " line " << problem.line << ": " << problem.description << '\n';
+
+	for (const std::pair<long, long> &range : audit.missingIds) {
+		if (range.first == range.second)
+			out << csv << ": no row has province ID " << range.first << '\n';
+		else
+			out << csv << ": no rows have province IDs " << range.first << " to " << range.second << '\n';
+	}
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+}
+
+/*Copy csv to path with the leading fields of the changed rows replaced. The mapping is closed on return, so the copy may then replace csv itself.*/
+
+static bool writeRepairedCopy(const std::string &csv, const DefinitionAudit &audit, const std::vector<Color> &newColor, const std::vector<bool> &colorChanges,
+	const std::vector<long> &newId, const std::string &path) {
+
+	FILE *file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL)
+		return false;
+
+	MappedFile definition(csv);
+	const char *data = definition.begin();
+	size_t copied = 0;
+	bool written = true;
+
+	for (size_t i = 0; i < audit.rows.size() && written; i++) {
+
+		if (!colorChanges[i] && newId[i] < 0)
+			continue;
+
+		const DefinitionRow &row = audit.rows[i];
+		long id = newId[i] >= 0 ? newId[i] : row.provinceId;
+		char fields[64];
+		int length = colorChanges[i]
+			? std::snprintf(fields, sizeof(fields), "%ld;%u;%u;%u", id, redOf(newColor[i]), greenOf(newColor[i]), blueOf(newColor[i]))
+			: std::snprintf(fields, sizeof(fields), "%ld;%ld;%ld;%ld", id, row.channels[0], row.channels[1], row.channels[2]);
+
+		written = std::fwrite(data + copied, 1, row.begin - copied, file) == row.begin - copied
+			&& std::fwrite(fields, 1, length, file) == (size_t)length;
+		copied = row.fieldsEnd;
+
+	}
+
+	written = written && std::fwrite(data + copied, 1, definition.size() - copied, file) == definition.size() - copied;
+
+	return std::fclose(file) == 0 && written;
+
+}
+
+void repairDefinition(const std::string &csv, const DefinitionAudit &audit, const ColorList &freshColors, const std::string &repairedPath) {
+
+	if (freshColors.size() < audit.colorsToReplace())
+		throw std::runtime_error("Repairing " + csv + " needs " + std::to_string(audit.colorsToReplace()) + " fresh colors.");
+
+	/* Work out the new fields of every row that changes, keyed by row index. */
+
+	std::vector<Color> newColor(audit.rows.size());
+	std::vector<bool> colorChanges(audit.rows.size(), false);
+	std::vector<long> newId(audit.rows.size(), -1);
+	std::vector<size_t> recolored(audit.badChannels);
+	size_t nextColor = 0;
+
+	recolored.insert(recolored.end(), audit.duplicateColors.begin(), audit.duplicateColors.end());
+	std::sort(recolored.begin(), recolored.end());
+
+	for (size_t i : recolored) {
+		newColor[i] = freshColors[nextColor++];
+		colorChanges[i] = true;
+	}
+
+	std::vector<size_t> renumbered(audit.negativeIds);
+	size_t range = 0;
+	long candidate = audit.missingIds.empty() ? audit.maxProvinceId + 1 : audit.missingIds[0].first;
+	long nextNewId = audit.maxProvinceId + 1;
+
+	renumbered.insert(renumbered.end(), audit.duplicateIds.begin(), audit.duplicateIds.end());
+	std::sort(renumbered.begin(), renumbered.end());
+
+	for (size_t i : renumbered) {
+		if (range < audit.missingIds.size()) {
+			newId[i] = candidate;
+			if (++candidate > audit.missingIds[range].second && ++range < audit.missingIds.size())
+				candidate = audit.missingIds[range].first;
+		}
+		else
+			newId[i] = nextNewId++;
+	}
+
+	std::string temporary = repairedPath + ".tmp";
+
+	if (!writeRepairedCopy(csv, audit, newColor, colorChanges, newId, temporary)) {
+		std::remove(temporary.c_str());
+		throw std::runtime_error("Could not write " + repairedPath + ".");
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, repairedPath, error);
+
+	if (error) {
+		std::remove(temporary.c_str());
+		throw std::runtime_error("Could not write " + repairedPath + ".");
+	}
+
+}
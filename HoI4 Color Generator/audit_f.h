@@ -0,0 +1,78 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Audit of one definition.csv for the mistakes the game does not forgive but getReservedList does not report.
+
+auditDefinition reads the whole file, split into line-aligned chunks parsed on up to `threads` threads (0 uses every core), and records every problem
+instead of stopping at the first:
+	malformed lines that do not start with four numbers (skipped like the parser does: blank lines, # comments, a header on line 1);
+	rows with a channel outside 0-255, or a negative province ID;
+	rows whose color an earlier row already uses;
+	rows whose province ID an earlier row already uses;
+	province IDs from 1 to the highest that no row uses.
+Rows are numbered by line, so every problem points at the line to fix.
+
+repairDefinition writes a copy of the file with the rows that can be fixed without touching the map:
+rows with a duplicate or out-of-range color get the next of freshColors (colorsToReplace of them are needed),
+and rows with a negative or reused province ID get the lowest missing IDs, then IDs above the highest. Everything else is copied byte for byte.
+Malformed lines and missing IDs are left for a person to fix. Throws std::runtime_error if the file cannot be written.
+*/
+
+struct DefinitionRow {
+	unsigned long line;
+	long provinceId;
+	long channels[3];
+	size_t begin;				// Offset of the line in the file.
+	size_t fieldsEnd;			// Offset just past the blue value; the rest of the line is kept as is.
+};
+
+struct DefinitionProblem {
+	unsigned long line;
+	std::string description;
+};
+
+struct DefinitionAudit {
+	unsigned long lines = 0;
+	long maxProvinceId = 0;
+	std::vector<DefinitionRow> rows;					// Every row that starts with four numbers, in file order.
+	std::vector<DefinitionProblem> malformed;
+	std::vector<size_t> badChannels;					// Indices into rows.
+	std::vector<size_t> negativeIds;
+	std::vector<size_t> duplicateColors;
+	std::vector<size_t> duplicateIds;
+	std::vector<std::pair<long, long>> missingIds;		// Inclusive ranges.
+	ColorBitmap colors;									// Every valid color in the file.
+
+	unsigned long colorsToReplace() const { return (unsigned long)(badChannels.size() + duplicateColors.size()); }
+	unsigned long missingIdCount() const;
+	bool clean() const;
+};
+
+DefinitionAudit auditDefinition(const std::string &csv, unsigned int threads = 0);
+
+void writeAuditReport(const std::string &path, const std::string &csv, const DefinitionAudit &audit);
+
+void repairDefinition(const std::string &csv, const DefinitionAudit &audit, const ColorList &freshColors, const std::string &repairedPath);
@@ -0,0 +1,275 @@
+#include "cache_f.h"
+#include "definition_f.h"
+#include "mapped_file_f.h"
+#include "stats_f.h"
+#include <cstdio>
+#include <filesystem>
+#include <random>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const char CACHE_MAGIC[8] = { 'C', 'C', 'F', 'R', 'S', 'V', '0', '2' };
+static const size_t BITMAP_BYTES = COLOR_SPACE_SIZE / 8;
+
+/*Header at the start of a cache file, followed by the bitmap words. Stored field by field as little-endian integers, HEADER_BYTES in all.*/
+
+struct CacheHeader {
+	char magic[8];
+	uint64_t sourceSize;			// Bytes of definition.csv covered by the cache.
+	int64_t sourceModified;			// Modification time of definition.csv when the cache was written.
+	uint64_t sourceHash;			// FNV-1a hash of those bytes.
+	uint64_t provinceCount;
+	int64_t maxProvinceId;
+	uint64_t lineCount;				// Lines read, so appended rows are numbered correctly.
+	uint32_t endsWithNewline;		// Appending is only safe if the last covered line was complete.
+};
+
+static const size_t HEADER_BYTES = 64;
+
+static void putLittleEndian(unsigned char *out, uint64_t value, int bytes) {
+
+	for (int i = 0; i < bytes; i++)
+		out[i] = (unsigned char)(value >> (8 * i));
+
+}
+
+static uint64_t getLittleEndian(const unsigned char *in, int bytes) {
+
+	uint64_t value = 0;
+
+	for (int i = 0; i < bytes; i++)
+		value |= (uint64_t)in[i] << (8 * i);
+
+	return value;
+
+}
+
+/*The last four bytes are zero, so the bitmap after the header starts on an 8-byte boundary.*/
+
+static void encodeHeader(const CacheHeader &header, unsigned char *out) {
+
+	memset(out, 0, HEADER_BYTES);
+	memcpy(out, header.magic, sizeof(header.magic));
+	putLittleEndian(out + 8, header.sourceSize, 8);
+	putLittleEndian(out + 16, (uint64_t)header.sourceModified, 8);
+	putLittleEndian(out + 24, header.sourceHash, 8);
+	putLittleEndian(out + 32, header.provinceCount, 8);
+	putLittleEndian(out + 40, (uint64_t)header.maxProvinceId, 8);
+	putLittleEndian(out + 48, header.lineCount, 8);
+	putLittleEndian(out + 56, header.endsWithNewline, 4);
+
+}
+
+static CacheHeader decodeHeader(const unsigned char *in) {
+
+	CacheHeader header;
+
+	memcpy(header.magic, in, sizeof(header.magic));
+	header.sourceSize = getLittleEndian(in + 8, 8);
+	header.sourceModified = (int64_t)getLittleEndian(in + 16, 8);
+	header.sourceHash = getLittleEndian(in + 24, 8);
+	header.provinceCount = getLittleEndian(in + 32, 8);
+	header.maxProvinceId = (int64_t)getLittleEndian(in + 40, 8);
+	header.lineCount = getLittleEndian(in + 48, 8);
+	header.endsWithNewline = (uint32_t)getLittleEndian(in + 56, 4);
+
+	return header;
+
+}
+
+/*64-bit FNV-1a. Streaming, so a prefix hash can be extended over appended bytes.*/
+
+static uint64_t fnv1a(uint64_t hash, const char *bytes, size_t length) {
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+
+}
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ull;
+
+static int64_t modificationTime(const std::string &path) {
+	return (int64_t)std::filesystem::last_write_time(path).time_since_epoch().count();
+}
+
+/*
+Write the cache next to the CSV through a temporary file so readers never see half a cache.
+The temporary name is random, so two runs writing the same cache at once do not write into one file.
+*/
+
+static void writeCache(const std::string &cachePath, const CacheHeader &header, const ColorBitmap &bitmap) {
+
+	char suffix[24];
+	std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", (unsigned int)std::random_device()());
+	std::string temporary = cachePath + suffix;
+
+	try {
+
+		FILE *file = std::fopen(temporary.c_str(), "wb");
+
+		if (file == NULL)
+			return;
+
+		unsigned char headerBytes[HEADER_BYTES];
+		encodeHeader(header, headerBytes);
+
+		bool written = std::fwrite(headerBytes, 1, HEADER_BYTES, file) == HEADER_BYTES
+			&& std::fwrite(bitmap.words.data(), 1, BITMAP_BYTES, file) == BITMAP_BYTES;
+
+		if (std::fclose(file) != 0 || !written) {
+			std::remove(temporary.c_str());
+			return;
+		}
+
+		std::filesystem::rename(temporary, cachePath);
+
+	}
+	catch (...) {
+		std::remove(temporary.c_str());
+	}
+
+}
+
+ReservedSet loadReservedSet(const std::string &csv, bool useCache) {
+
+	ReservedSet set;
+
+	if (!useCache) {
+		ColorList values;
+		{
+			StageTimer stage("parse");
+			values = getReservedList(csv, &set.maxProvinceId);
+		}
+		StageTimer stage("index");
+		set.bitmap = hashReservedList(values);
+		set.provinceCount = values.size();
+		return set;
+	}
+
+	std::error_code missing;
+
+	if (!std::filesystem::is_regular_file(csv, missing))
+		throw std::runtime_error("Cannot open " + csv + ".");
+
+	std::string cachePath = csv + ".cache";
+	uint64_t sourceSize = std::filesystem::file_size(csv);
+	int64_t sourceModified = modificationTime(csv);
+	CacheHeader cached;
+	bool haveCache = false;
+
+	/* Fast path: size and modification time match, so the CSV is not even opened. */
+
+	try {
+		StageTimer stage("read cache");
+		MappedFile cache(cachePath);
+		if (cache.size() == HEADER_BYTES + BITMAP_BYTES) {
+			cached = decodeHeader((const unsigned char *)cache.begin());
+			haveCache = memcmp(cached.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0;
+			if (haveCache) {
+				memcpy(set.bitmap.words.data(), cache.begin() + HEADER_BYTES, BITMAP_BYTES);
+				set.provinceCount = (unsigned long)cached.provinceCount;
+				set.maxProvinceId = (long)cached.maxProvinceId;
+			}
+		}
+	}
+	catch (const std::exception &) {
+		haveCache = false;
+	}
+
+	if (haveCache && cached.sourceSize == sourceSize && cached.sourceModified == sourceModified) {
+		set.cacheStatus = "cached";
+		return set;
+	}
+
+	MappedFile source(csv);
+	CacheHeader header;
+	memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+
+	uint64_t prefixHash = haveCache && cached.sourceSize <= source.size() ? fnv1a(FNV_OFFSET, source.begin(), (size_t)cached.sourceSize) : 0;
+
+	if (haveCache && cached.sourceSize == source.size() && prefixHash == cached.sourceHash) {
+
+		/* Same contents, new timestamp: keep the cached bitmap and record the new time. */
+
+		header = cached;
+		set.cacheStatus = "cached";
+
+	}
+	else if (haveCache && cached.sourceSize < source.size() && cached.endsWithNewline && prefixHash == cached.sourceHash) {
+
+		/* Rows were appended: parse only the new bytes and add them to the cached bitmap. */
+
+		ColorList appended;
+		long highestId = (long)cached.maxProvinceId;
+		const char *tail = source.begin() + cached.sourceSize;
+
+		StageTimer stage("parse appended");
+
+		header.lineCount = cached.lineCount + parseDefinitionText(tail, source.end(), csv, (unsigned long)cached.lineCount + 1, appended, highestId);
+
+		for (size_t i = 0; i < appended.size(); i++)
+			set.bitmap.set(appended[i]);
+
+		set.provinceCount += appended.size();
+		set.maxProvinceId = highestId;
+		header.sourceHash = fnv1a(prefixHash, tail, source.end() - tail);
+		set.cacheStatus = "appended";
+
+	}
+	else {
+
+		ColorList values;
+		long highestId = 0;
+
+		{
+			StageTimer stage("parse");
+			header.lineCount = parseDefinitionText(source.begin(), source.end(), csv, 1, values, highestId);
+		}
+
+		{
+			StageTimer stage("index");
+			set.bitmap = hashReservedList(values);
+		}
+
+		set.provinceCount = values.size();
+		set.maxProvinceId = highestId;
+		header.sourceHash = fnv1a(FNV_OFFSET, source.begin(), source.size());
+		set.cacheStatus = "parsed";
+
+	}
+
+	header.sourceSize = source.size();
+	header.sourceModified = sourceModified;
+	header.provinceCount = set.provinceCount;
+	header.maxProvinceId = set.maxProvinceId;
+	header.endsWithNewline = source.size() > 0 && source.end()[-1] == '\n';
+
+	StageTimer stage("write cache");
+	writeCache(cachePath, header, set.bitmap);
+
+	return set;
+
+}
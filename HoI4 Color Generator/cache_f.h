@@ -0,0 +1,45 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ReservedSet is the reserved bitmap together with what main reports about its definition.csv.
+cacheStatus says how it was obtained: "parsed", "cached" or "appended" (cache updated with rows added since it was written).
+*/
+
+struct ReservedSet {
+	ColorBitmap bitmap;
+	unsigned long provinceCount = 0;
+	long maxProvinceId = 0;
+	std::string cacheStatus = "parsed";
+};
+
+/*
+loadReservedSet reads a definition.csv into a ReservedSet, keeping a cache of the bitmap in <csv>.cache.
+A cache whose recorded size and modification time still match is used without reading the CSV.
+Otherwise the CSV is hashed: an unchanged file reuses the cache, and a file that has only grown has just its new rows parsed.
+Anything else is parsed from scratch. Cache files that cannot be written are skipped silently.
+*/
+
+ReservedSet loadReservedSet(const std::string &csv, bool useCache = true);
@@ -0,0 +1,645 @@
+#include "cli_f.h"
+#include "perceptual_f.h"
+#include "stats_f.h"
+#include "luminance_index_f.h"
+#include "stream_f.h"
+#include "permutation_f.h"
+#include "region_f.h"
+#include <memory>
+#include <sstream>
+#include <cerrno>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*Read a whole-number argument and check it against a range.*/
+
+static long parseNumber(const std::string &flag, const std::string &text, long minimum, long maximum) {
+
+	char *end = NULL;
+	long value = std::strtol(text.c_str(), &end, 10);
+
+	if (text.empty() || *end != '\0' || value < minimum || value > maximum)
+		throw std::runtime_error(flag + " expects a number from " + std::to_string(minimum) + " to " + std::to_string(maximum) + ", got \"" + text + "\".");
+
+	return value;
+
+}
+
+/*
+	Apply one job flag. Returns how many extra tokens it consumed, or -1 if the flag is not a job flag.
+	Shared by the command line and batch files so both accept the same spelling.
+*/
+
+static int applyJobFlag(GenerationJob &job, const std::vector<std::string> &tokens, size_t i) {
+
+	const std::string &flag = tokens[i];
+	size_t remaining = tokens.size() - i - 1;
+
+	static const char *clampFlags[6] = { "--min-red", "--min-green", "--min-blue", "--max-red", "--max-green", "--max-blue" };
+
+	for (int c = 0; c < 6; c++) {
+		if (flag == clampFlags[c]) {
+			if (remaining < 1)
+				throw std::runtime_error(flag + " expects a value.");
+			job.clampVals[c] = (short)parseNumber(flag, tokens[i + 1], 0, 255);
+			return 1;
+		}
+	}
+
+	if (flag == "--sort") {
+		job.sort = true;
+		return 0;
+	}
+
+	if (flag == "--clamp") {
+		if (remaining < 6)
+			throw std::runtime_error("--clamp expects six values: min red, green, blue, then max red, green, blue.");
+		for (int c = 0; c < 6; c++)
+			job.clampVals[c] = (short)parseNumber(flag, tokens[i + 1 + c], 0, 255);
+		return 6;
+	}
+
+	if (flag == "--luma") {
+		if (remaining < 2)
+			throw std::runtime_error("--luma expects two values: minimum and maximum luminance.");
+		job.minLuminance = (short)parseNumber(flag, tokens[i + 1], 0, 255);
+		job.maxLuminance = (short)parseNumber(flag, tokens[i + 2], 0, 255);
+		return 2;
+	}
+
+	if (flag != "--count" && flag != "--contrast" && flag != "--threads" && flag != "--delta-e" && flag != "--seed" && flag != "--text" && flag != "--bmp"
+		&& flag != "--format" && flag != "--definition-fields" && flag != "--image-width" && flag != "--region" && flag != "--exclude-region")
+		return -1;
+
+	if (remaining < 1)
+		throw std::runtime_error(flag + " expects a value.");
+
+	const std::string &value = tokens[i + 1];
+
+	if (flag == "--count")
+		job.pCount = value == "all" ? COUNT_ALL : parseNumber(flag, value, 1, COLOR_SPACE_SIZE);
+	else if (flag == "--contrast")
+		job.mContrast = (short)parseNumber(flag, value, 1, 255);
+	else if (flag == "--threads")
+		job.threads = (unsigned int)parseNumber(flag, value, 1, 1024);
+	else if (flag == "--delta-e") {
+		char *end = NULL;
+		job.minDeltaE = std::strtod(value.c_str(), &end);
+		if (value.empty() || *end != '\0' || job.minDeltaE <= 0 || job.minDeltaE > 100)
+			throw std::runtime_error("--delta-e expects a number greater than 0 and at most 100, got \"" + value + "\".");
+	}
+	else if (flag == "--seed") {
+		char *end = NULL;
+		errno = 0;
+		job.seed = std::strtoull(value.c_str(), &end, 10);
+		if (value.empty() || *end != '\0' || errno == ERANGE || value.find_first_not_of("0123456789") != std::string::npos)
+			throw std::runtime_error("--seed expects a whole number, got \"" + value + "\".");
+		job.seeded = true;
+	}
+	else if (flag == "--image-width")
+		job.imageWidth = (int)parseNumber(flag, value, 1, 65535);
+	else if (flag == "--format")
+		job.format = parseOutputFormat(value);
+	else if (flag == "--region")
+		job.regions.push_back(value);
+	else if (flag == "--exclude-region")
+		job.excludedRegions.push_back(value);
+	else if (flag == "--definition-fields")
+		job.definitionFields = value;
+	else if (flag == "--text")
+		job.textPath = value;
+	else
+		job.bmpPath = value;
+
+	return 1;
+
+}
+
+bool isStreamingJob(const GenerationJob &job) {
+	return job.pCount > MAX_VALUES_TO_GENERATE;
+}
+
+static bool hasLuminanceBand(const GenerationJob &job) {
+	return job.minLuminance > 0 || job.maxLuminance < 255;
+}
+
+/*
+	Check the constraints that span several flags. needsCount is false for modes whose job flags only shape colors made some other way
+	(the defaults of a batch file, --audit --repair, --serve, --color-provinces); every other constraint still applies to them.
+*/
+
+static void validateJob(const GenerationJob &job, bool needsCount = true) {
+
+	if (needsCount && job.pCount < 1)
+		throw std::runtime_error("--count is required.");
+
+	for (int c = 0; c < 3; c++) {
+		if (job.clampVals[c] > job.clampVals[c + 3])
+			throw std::runtime_error("Minimum clamp values must not exceed the matching maximum.");
+	}
+
+	if (job.minLuminance > job.maxLuminance)
+		throw std::runtime_error("--luma minimum must not exceed the maximum.");
+
+	if (job.minDeltaE > 0 && hasLuminanceBand(job))
+		throw std::runtime_error("--luma cannot be combined with --delta-e.");
+
+	for (const std::string &region : job.regions)
+		validateRegion(region);
+
+	for (const std::string &region : job.excludedRegions)
+		validateRegion(region);
+
+	if (job.definitionFields.size() > MAX_DEFINITION_FIELDS_LENGTH || job.definitionFields.find_first_of("\r\n") != std::string::npos)
+		throw std::runtime_error("--definition-fields must be one line of at most " + std::to_string(MAX_DEFINITION_FIELDS_LENGTH) + " characters.");
+
+	if (job.seeded && (job.minDeltaE > 0 || hasLuminanceBand(job)))
+		throw std::runtime_error("--seed cannot be combined with --delta-e or --luma.");
+
+	if (isStreamingJob(job) && (job.sort || job.minDeltaE > 0 || hasLuminanceBand(job)))
+		throw std::runtime_error("--sort, --delta-e and --luma hold every color in memory and are limited to " + std::to_string(MAX_VALUES_TO_GENERATE) + " colors.");
+
+}
+
+CommandLine parseCommandLine(int argc, char *argv[]) {
+
+	CommandLine options;
+	std::vector<std::string> tokens(argv + 1, argv + argc);
+
+	for (size_t i = 0; i < tokens.size(); i++) {
+
+		int consumed = applyJobFlag(options.job, tokens, i);
+
+		if (consumed >= 0) {
+			i += consumed;
+			continue;
+		}
+
+		if (tokens[i] == "--help" || tokens[i] == "-h") {
+			options.help = true;
+		}
+		else if (tokens[i] == "--no-cache") {
+			options.useCache = false;
+		}
+		else if (tokens[i] == "--list-regions") {
+			options.listRegions = true;
+		}
+		else if (tokens[i] == "--stats") {
+			options.stats = true;
+		}
+		else if (tokens[i] == "--input" && i + 1 < tokens.size()) {
+			/* --input takes every path up to the next flag, so shell globs work. */
+			while (i + 1 < tokens.size() && tokens[i + 1].compare(0, 2, "--") != 0)
+				options.inputPaths.push_back(tokens[++i]);
+		}
+		else if (tokens[i] == "--batch" && i + 1 < tokens.size()) {
+			options.batchPath = tokens[++i];
+		}
+		else if (tokens[i] == "--trace" && i + 1 < tokens.size()) {
+			options.tracePath = tokens[++i];
+		}
+		else if (tokens[i] == "--collisions" && i + 1 < tokens.size()) {
+			options.collisionsPath = tokens[++i];
+		}
+		else if (tokens[i] == "--province-map" && i + 1 < tokens.size()) {
+			options.provinceMapPath = tokens[++i];
+		}
+		else if (tokens[i] == "--map-report" && i + 1 < tokens.size()) {
+			options.mapReportPath = tokens[++i];
+		}
+		else if (tokens[i] == "--color-provinces" && i + 1 < tokens.size()) {
+			options.colorProvincesPath = tokens[++i];
+		}
+		else if (tokens[i] == "--serve" && i + 1 < tokens.size()) {
+			options.servePath = tokens[++i];
+		}
+		else if (tokens[i] == "--connect" && i + 1 < tokens.size()) {
+			options.connectPath = tokens[++i];
+		}
+		else if (tokens[i] == "--audit" && i + 1 < tokens.size()) {
+			options.auditPath = tokens[++i];
+		}
+		else if (tokens[i] == "--audit-report" && i + 1 < tokens.size()) {
+			options.auditReportPath = tokens[++i];
+		}
+		else if (tokens[i] == "--repair" && i + 1 < tokens.size()) {
+			options.repairPath = tokens[++i];
+		}
+		else if (tokens[i] == "--journal" && i + 1 < tokens.size()) {
+			options.journalPath = tokens[++i];
+		}
+		else {
+			throw std::runtime_error("Unknown or incomplete argument " + tokens[i] + ".");
+		}
+
+	}
+
+	if (options.inputPaths.empty())
+		options.inputPaths.push_back("definition.csv");
+
+	if (options.journalPath.empty())
+		options.journalPath = options.inputPaths[0] + ".journal";
+
+	if (!options.servePath.empty() && !options.connectPath.empty())
+		throw std::runtime_error("--serve and --connect cannot be used together.");
+
+	if (options.auditPath.empty() && (!options.auditReportPath.empty() || !options.repairPath.empty()))
+		throw std::runtime_error("--audit-report and --repair need --audit.");
+
+	if (!options.colorProvincesPath.empty() && options.provinceMapPath.empty())
+		throw std::runtime_error("--color-provinces needs --province-map.");
+
+	options.interactive = options.job.pCount == 0 && options.batchPath.empty() && options.servePath.empty() && options.auditPath.empty() && options.colorProvincesPath.empty();
+
+	if (options.help || options.listRegions)
+		return options;
+
+	if (!options.interactive)
+		validateJob(options.job, options.batchPath.empty() && options.servePath.empty() && options.auditPath.empty() && options.colorProvincesPath.empty());
+
+	return options;
+
+}
+
+/*Split a batch line on whitespace. Double quotes group paths that contain spaces.*/
+
+static std::vector<std::string> tokenize(const std::string &line) {
+
+	std::vector<std::string> tokens;
+	std::string token;
+	bool quoted = false;
+	bool inToken = false;
+
+	for (size_t i = 0; i < line.size(); i++) {
+		char c = line[i];
+		if (c == '"') {
+			quoted = !quoted;
+			inToken = true;
+		}
+		else if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+			if (inToken)
+				tokens.push_back(token);
+			token.clear();
+			inToken = false;
+		}
+		else {
+			token += c;
+			inToken = true;
+		}
+	}
+
+	if (inToken)
+		tokens.push_back(token);
+
+	return tokens;
+
+}
+
+/*Build a job from job flags alone, starting from defaults, and validate it. Used for batch lines and server requests.*/
+
+GenerationJob parseJobTokens(const std::vector<std::string> &tokens, const GenerationJob &defaults) {
+
+	GenerationJob job = defaults;
+
+	for (size_t i = 0; i < tokens.size(); i++) {
+		int consumed = applyJobFlag(job, tokens, i);
+		if (consumed < 0)
+			throw std::runtime_error("Unknown or incomplete argument " + tokens[i] + ".");
+		i += consumed;
+	}
+
+	validateJob(job);
+
+	return job;
+
+}
+
+GenerationJob parseJobLine(const std::string &line, const GenerationJob &defaults) {
+	return parseJobTokens(tokenize(line), defaults);
+}
+
+/*The generation settings of a job as flags that parseJobLine reads back. Output paths and formats are left out.*/
+
+std::string formatJobFlags(const GenerationJob &job) {
+
+	std::ostringstream flags;
+
+	flags << "--count " << job.pCount << " --contrast " << job.mContrast << " --clamp";
+
+	for (int c = 0; c < 6; c++)
+		flags << " " << job.clampVals[c];
+
+	if (job.threads > 0)
+		flags << " --threads " << job.threads;
+
+	if (job.minDeltaE > 0)
+		flags << " --delta-e " << std::setprecision(17) << job.minDeltaE;
+
+	if (job.seeded)
+		flags << " --seed " << job.seed;
+
+	if (job.minLuminance > 0 || job.maxLuminance < 255)
+		flags << " --luma " << job.minLuminance << " " << job.maxLuminance;
+
+	for (const std::string &region : job.regions)
+		flags << " --region " << region;
+
+	for (const std::string &region : job.excludedRegions)
+		flags << " --exclude-region " << region;
+
+	if (job.sort)
+		flags << " --sort";
+
+	return flags.str();
+
+}
+
+/*
+	Read a batch file with one job per line, written with the same flags as the command line.
+	Blank lines and lines starting with # are skipped. Each job starts from the command line's job settings.
+*/
+
+std::vector<GenerationJob> readBatchFile(const std::string &path, const GenerationJob &defaults) {
+
+	std::ifstream batch(path);
+	std::vector<GenerationJob> jobs;
+	unsigned long lineNumber = 0;
+
+	if (!batch)
+		throw std::runtime_error("Cannot open batch file " + path + ".");
+
+	for (std::string line; std::getline(batch, line); ) {
+
+		lineNumber++;
+		std::vector<std::string> tokens = tokenize(line);
+
+		if (tokens.empty() || tokens[0][0] == '#')
+			continue;
+
+		try {
+			jobs.push_back(parseJobTokens(tokens, defaults));
+		}
+		catch (const std::exception &e) {
+			throw std::runtime_error(path + " line " + std::to_string(lineNumber) + ": " + e.what());
+		}
+
+	}
+
+	return jobs;
+
+}
+
+/*
+	The bitmap a job generates against: reserved alone, or with everything outside the job's regions marked as well.
+	storage owns the combined bitmap when there is one.
+*/
+
+static const ColorBitmap &jobBitmap(const GenerationJob &job, const ColorBitmap &reserved, std::unique_ptr<ColorBitmap> &storage) {
+
+	if (job.regions.empty() && job.excludedRegions.empty())
+		return reserved;
+
+	storage.reset(new ColorBitmap(constrainReserved(reserved, job.regions, job.excludedRegions)));
+
+	return *storage;
+
+}
+
+/*
+	Luminance band: index the free colors of the clamp box by luminance, check the band's count, and take colors darkest first.
+	The result is already in brightness order.
+*/
+
+static ColorList generateBandValues(const ColorBitmap &reserved, const GenerationJob &job, short *clampVals) {
+
+	progressOutput() << "Generating unreserved colors with luminance " << job.minLuminance << " to " << job.maxLuminance << "..." << std::endl;
+
+	LuminanceIndex index(reserved, clampVals);
+	unsigned long available = index.count(job.minLuminance, job.maxLuminance);
+
+	if ((unsigned long)job.pCount > available)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(available) + " unreserved colors in the clamped range have that luminance.");
+
+	ColorList values = index.take(job.minLuminance, job.maxLuminance, job.pCount, job.mContrast);
+
+	if ((long)values.size() < job.pCount)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(values.size()) + " meet the constraints.");
+
+	return values;
+
+}
+
+/*Generate colors for one job with the mode it asks for. Throws if the constraints cannot be met.*/
+
+ColorList runGenerationJob(const GenerationJob &job, const ColorBitmap &jobReserved) {
+
+	short clampVals[6];
+	std::copy(job.clampVals, job.clampVals + 6, clampVals);
+
+	std::unique_ptr<ColorBitmap> constrained;
+	const ColorBitmap &reserved = jobBitmap(job, jobReserved, constrained);
+	ColorList values;
+
+	{
+		StageTimer stage("generate");
+
+		if (hasLuminanceBand(job))
+			values = generateBandValues(reserved, job, clampVals);
+		else if (job.minDeltaE > 0)
+			values = generatePerceptualValues(reserved, job.pCount, job.minDeltaE, clampVals);
+		else if (job.seeded)
+			values = generateSeededValues(reserved, job.pCount, job.mContrast, clampVals, job.seed);
+		else if (job.threads > 0)
+			values = generateShardedValues(reserved, job.pCount, job.mContrast, clampVals, job.threads);
+		else
+			values = generateUnreservedValues(reserved, job.pCount, job.mContrast, clampVals);
+	}
+
+	if (job.sort && !hasLuminanceBand(job)) {
+		StageTimer stage("sort");
+		luminanceSort(values);
+	}
+
+	return values;
+
+}
+
+/*Write values to a list in the job's format and a preview image. Definition rows are numbered from firstProvinceId.*/
+
+void writeJobOutput(const GenerationJob &job, const ColorList &values, long firstProvinceId) {
+
+	{
+		StageTimer stage("write list");
+		writeColors(values, job.textPath, job.format, firstProvinceId, job.definitionFields);
+	}
+
+	StageTimer stage("write image");
+	writeImage(values, job.bmpPath, job.imageWidth);
+
+}
+
+/*Colors a stream yields, up to limit. Used to size the image before a streamed job writes anything.*/
+
+template <class Stream>
+static unsigned long countStreamed(Stream &stream, ColorList &chunk, unsigned long limit) {
+
+	unsigned long total = 0;
+
+	for (size_t n; total < limit && (n = stream.next(chunk.data(), std::min((unsigned long)chunk.size(), limit - total))) > 0; )
+		total += n;
+
+	return total;
+
+}
+
+/*Pass total colors from stream to both writers a chunk at a time.*/
+
+template <class Stream>
+static void writeStreamed(Stream &stream, ColorList &chunk, unsigned long total, ColorWriter &list, ImageWriter &image) {
+
+	ProgressMeter meter(total);
+
+	for (unsigned long written = 0; written < total; ) {
+		size_t n = stream.next(chunk.data(), std::min((unsigned long)chunk.size(), total - written));
+		list.write(chunk.data(), n);
+		image.write(chunk.data(), n);
+		meter.advance(n);
+		written += n;
+	}
+
+	list.finish();
+	image.finish();
+	recordCounters(stream.counters());
+
+}
+
+/*
+	Streaming form of runGenerationJob and writeJobOutput for counts past MAX_VALUES_TO_GENERATE.
+	Colors go from a ColorStream (or a PermutedColorStream with --seed) to the list and image writers one chunk at a time, so memory use is the same for any count.
+	The image needs its size before the first row, so the count is settled first: countFreeColors gives it directly,
+	and with a contrast above 1 a counting pass over the stream does. Either way a request that cannot be met fails before any file is opened.
+	COUNT_ALL takes every color the constraints allow. Returns the number of colors written.
+*/
+
+unsigned long streamJobOutput(const GenerationJob &job, const ColorBitmap &jobReserved, long firstProvinceId) {
+
+	std::unique_ptr<ColorBitmap> constrained;
+	const ColorBitmap &reserved = jobBitmap(job, jobReserved, constrained);
+	ColorList chunk(65536);
+	unsigned long total = 0;
+
+	{
+		StageTimer stage("count");
+		unsigned long wanted = job.pCount == COUNT_ALL ? COLOR_SPACE_SIZE : (unsigned long)job.pCount;
+		short clampVals[6];
+		std::copy(job.clampVals, job.clampVals + 6, clampVals);
+
+		if (job.mContrast <= 1)
+			total = countFreeColors(reserved, clampVals);
+		else if (job.seeded) {
+			PermutedColorStream counter(reserved, job.clampVals, job.seed, job.mContrast);
+			total = countStreamed(counter, chunk, wanted);
+		}
+		else {
+			ColorStream counter(reserved, job.clampVals, job.mContrast);
+			total = countStreamed(counter, chunk, wanted);
+		}
+
+		if (job.pCount != COUNT_ALL && total < wanted)
+			throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(total) + " meet the constraints.");
+
+		if (total == 0)
+			throw std::runtime_error("No unreserved colors meet the constraints.");
+
+		total = std::min(total, wanted);
+	}
+
+	progressOutput() << "Streaming " << total << " unreserved colors..." << std::endl;
+
+	StageTimer stage("stream");
+	ColorWriter list(job.textPath, job.format, firstProvinceId, job.definitionFields);
+	int width = job.imageWidth > 0 ? job.imageWidth : squarePalette((int)total);
+	ImageWriter image(job.bmpPath, imageFormatForPath(job.bmpPath), width, (int)((total + width - 1) / width));
+
+	if (job.seeded) {
+		PermutedColorStream stream(reserved, job.clampVals, job.seed, job.mContrast);
+		writeStreamed(stream, chunk, total, list, image);
+	}
+	else {
+		ColorStream stream(reserved, job.clampVals, job.mContrast);
+		writeStreamed(stream, chunk, total, list, image);
+	}
+
+	return total;
+
+}
+
+void printRegionPresets() {
+
+	for (const RegionPreset &preset : regionPresets())
+		std::cout << "  " << std::left << std::setw(16) << preset.name << std::setw(36) << preset.spec << preset.description << std::endl;
+
+}
+
+void printUsage() {
+
+	std::cout << "Usage: [options]" << std::endl;
+	std::cout << "Without --count or --batch the program asks for each setting interactively." << std::endl << std::endl;
+	std::cout << "  --input PATH...     definition files, or directories to search for definition.csv, to reserve colors from" << std::endl;
+	std::cout << "                      (default definition.csv); several are loaded in parallel and merged" << std::endl;
+	std::cout << "  --collisions FILE   list colors reserved by more than one input, with the files that use them" << std::endl;
+	std::cout << "  --province-map BMP  also reserve every color used in this provinces.bmp" << std::endl;
+	std::cout << "  --map-report FILE   list colors in the province map but not the definitions, and the reverse" << std::endl;
+	std::cout << "  --color-provinces BMP  write a copy of the --province-map with every province missing from the definitions" << std::endl;
+	std::cout << "                      recolored so neighbours differ as much as possible; their definition rows go to --text" << std::endl;
+	std::cout << "  --no-cache          neither read nor write the reserved-color cache (<input>.cache)" << std::endl;
+	std::cout << "  --count N           number of colors to generate, or all; counts above " << MAX_VALUES_TO_GENERATE << " are streamed" << std::endl;
+	std::cout << "                      to the outputs in packed order and cannot use --sort, --delta-e or --luma" << std::endl;
+	std::cout << "  --contrast N        minimum luminance contrast (1-255, default 1)" << std::endl;
+	std::cout << "  --clamp R G B R G B minimum then maximum red, green and blue values" << std::endl;
+	std::cout << "  --min-red N, --min-green N, --min-blue N, --max-red N, --max-green N, --max-blue N" << std::endl;
+	std::cout << "  --sort              sort the colors by brightness" << std::endl;
+	std::cout << "  --threads N         sharded generation on N threads" << std::endl;
+	std::cout << "  --delta-e X         keep every pair of colors at least X apart in CIELAB" << std::endl;
+	std::cout << "  --seed N            scatter the colors over the clamp box in an order fixed by N, instead of RGB order" << std::endl;
+	std::cout << "  --region SPEC       only colors inside SPEC: terms such as hsv:190-250,40-100,20-80, rgb:, lab:, chroma:0-10" << std::endl;
+	std::cout << "                      or a preset, joined by &; repeat to intersect several regions" << std::endl;
+	std::cout << "  --exclude-region SPEC  never colors inside SPEC, e.g. near-gray" << std::endl;
+	std::cout << "  --list-regions      list the region presets" << std::endl;
+	std::cout << "  --luma MIN MAX      only colors with luminance from MIN to MAX (0-255), darkest first" << std::endl;
+	std::cout << "  --text PATH         color list output (default unreserved.txt)" << std::endl;
+	std::cout << "  --format NAME       color list format: text, definition, json or binary (default text)" << std::endl;
+	std::cout << "  --definition-fields TEXT  fields after the color in definition rows (default land;false;plains;1)" << std::endl;
+	std::cout << "  --bmp PATH          image output, PNG if PATH ends in .png (default unreserved.bmp)" << std::endl;
+	std::cout << "  --image-width N     image width in pixels (default: smallest square)" << std::endl;
+	std::cout << "  --batch FILE        run one job per line of FILE, using the flags above" << std::endl;
+	std::cout << "  --audit CSV         check CSV for malformed rows, colors out of range, duplicate colors and IDs, and missing IDs" << std::endl;
+	std::cout << "  --audit-report FILE list every problem --audit finds, by line" << std::endl;
+	std::cout << "  --repair FILE       write a copy of the audited CSV with fresh colors for bad or duplicate colors and free IDs" << std::endl;
+	std::cout << "                      for duplicate IDs; --clamp, --seed, --region and the other job flags shape the new colors" << std::endl;
+	std::cout << "  --serve SOCKET      keep the reserved colors in memory and hand them out to --connect clients on SOCKET" << std::endl;
+	std::cout << "  --journal FILE      server allocation journal, replayed on start (default <first input>.journal)" << std::endl;
+	std::cout << "  --connect SOCKET    get this run's colors from a server instead of reading definition files" << std::endl;
+	std::cout << "  --stats             print time per stage, color counters and peak memory at the end" << std::endl;
+	std::cout << "  --trace FILE        write the same figures as a Chrome trace (JSON) to FILE" << std::endl;
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "generator_f.h"
+#include "writer_f.h"
+#include "image_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+GenerationJob holds every parameter the interactive prompts ask for, plus the generation mode and output paths.
+A pCount above MAX_VALUES_TO_GENERATE makes a streaming job (isStreamingJob), written by streamJobOutput; COUNT_ALL (--count all) asks for every free color.
+textPath receives the color list in the chosen format. Definition rows end with definitionFields.
+seeded selects the ColorPermutation order of permutation_f.h for seed instead of packed order.
+regions and excludedRegions are region specs (region_f.h); colors must lie inside every one of regions and outside all of excludedRegions.
+minLuminance and maxLuminance select a brightness band; a narrower band than 0-255 is served from a LuminanceIndex, darkest first.
+bmpPath receives the preview image (PNG when it ends in .png), imageWidth pixels wide or square when 0.
+CommandLine holds a parsed command line. inputPaths holds every --input file or directory, definition.csv if none was given.
+collisionsPath receives the colors reserved by more than one input.
+provinceMapPath is a provinces.bmp whose colors are reserved as well; mapReportPath receives the colors it and the definitions disagree on.
+colorProvincesPath receives a copy of that map whose provinces missing from the definitions are recolored by adjacency (adjacency_f.h).
+servePath runs the allocation server of server_f.h on that socket, journaling to journalPath (<first input>.journal by default).
+connectPath sends the job to such a server instead of reading definitions.
+auditPath is a definition.csv to audit (audit_f.h) instead of generating; auditReportPath receives its problems and repairPath its repaired copy.
+stats and tracePath request the instrumentation report of stats_f.h.
+listRegions asks for the region presets to be printed instead of running.
+interactive is true when neither --count nor --batch was given, in which case main falls back to validateUserInput.
+*/
+
+const long COUNT_ALL = COLOR_SPACE_SIZE;
+
+struct GenerationJob {
+	long pCount = 0;
+	short mContrast = 1;
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+	bool sort = false;
+	unsigned int threads = 0;
+	double minDeltaE = 0;
+	bool seeded = false;
+	uint64_t seed = 0;
+	short minLuminance = 0;
+	short maxLuminance = 255;
+	std::vector<std::string> regions;
+	std::vector<std::string> excludedRegions;
+	OutputFormat format = OutputFormat::Text;
+	std::string definitionFields = "land;false;plains;1";
+	std::string textPath = "unreserved.txt";
+	std::string bmpPath = "unreserved.bmp";
+	int imageWidth = 0;
+};
+
+struct CommandLine {
+	std::vector<std::string> inputPaths;
+	std::string collisionsPath;
+	std::string provinceMapPath;
+	std::string mapReportPath;
+	std::string colorProvincesPath;
+	std::string servePath;
+	std::string connectPath;
+	std::string journalPath;
+	std::string auditPath;
+	std::string auditReportPath;
+	std::string repairPath;
+	std::string batchPath;
+	GenerationJob job;
+	std::string tracePath;
+	bool useCache = true;
+	bool stats = false;
+	bool interactive = true;
+	bool help = false;
+	bool listRegions = false;
+};
+
+CommandLine parseCommandLine(int argc, char *argv[]);
+
+GenerationJob parseJobTokens(const std::vector<std::string> &tokens, const GenerationJob &defaults);
+
+GenerationJob parseJobLine(const std::string &line, const GenerationJob &defaults);
+
+std::string formatJobFlags(const GenerationJob &job);
+
+std::vector<GenerationJob> readBatchFile(const std::string &path, const GenerationJob &defaults);
+
+ColorList runGenerationJob(const GenerationJob &job, const ColorBitmap &reserved);
+
+void writeJobOutput(const GenerationJob &job, const ColorList &values, long firstProvinceId);
+
+bool isStreamingJob(const GenerationJob &job);
+
+unsigned long streamJobOutput(const GenerationJob &job, const ColorBitmap &reserved, long firstProvinceId);
+
+void printRegionPresets();
+
+void printUsage();
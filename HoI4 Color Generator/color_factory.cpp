@@ -0,0 +1,191 @@
+#include "color_factory.h"
+#include "perceptual_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const short FULL_CLAMP[6] = { 0, 0, 0, 255, 255, 255 };
+
+Generator::Generator() : rowCursor(0) {
+	std::copy(FULL_CLAMP, FULL_CLAMP + 6, cursorClamp);
+}
+
+Generator::Generator(const std::string &definitionCsv, bool useCache) : reserved(loadReservedSet(definitionCsv, useCache)), rowCursor(0) {
+	std::copy(FULL_CLAMP, FULL_CLAMP + 6, cursorClamp);
+}
+
+Generator::Generator(const ReservedSet &reserved) : reserved(reserved), rowCursor(0) {
+	std::copy(FULL_CLAMP, FULL_CLAMP + 6, cursorClamp);
+}
+
+Generator::Generator(const std::vector<std::string> &definitionInputs, bool useCache)
+	: reserved(mergeReservedSources(loadReservedSources(expandDefinitionInputs(definitionInputs), useCache))), rowCursor(0) {
+	std::copy(FULL_CLAMP, FULL_CLAMP + 6, cursorClamp);
+}
+
+/*Mark colors as taken, for example the colors of provinces created outside the generator.*/
+
+void Generator::reserve(ColorSpan colors) {
+
+	for (size_t i = 0; i < colors.size; i++)
+		reserved.bitmap.set(colors.data[i] & 0xFFFFFF);
+
+}
+
+/*Mark every color painted in a provinces.bmp as taken.*/
+
+void Generator::reserveProvinceMap(const std::string &provincesBmp) {
+
+	reserved.bitmap.merge(scanProvinceMap(provincesBmp).colors);
+
+}
+
+/*Free colors again. The cursor restarts because freed colors may lie behind it.*/
+
+void Generator::release(ColorSpan colors) {
+
+	for (size_t i = 0; i < colors.size; i++)
+		reserved.bitmap.reset(colors.data[i] & 0xFFFFFF);
+
+	rowCursor = 0;
+	index.reset();
+
+}
+
+unsigned long Generator::available(const GenerateOptions &options) const {
+
+	short clampVals[6];
+	std::copy(options.clampVals, options.clampVals + 6, clampVals);
+
+	if (options.minLuminance > 0 || options.maxLuminance < 255) {
+		if (index && std::equal(clampVals, clampVals + 6, indexClamp))
+			return index->count(options.minLuminance, options.maxLuminance, reserved.bitmap);
+		return LuminanceIndex(reserved.bitmap, clampVals).count(options.minLuminance, options.maxLuminance);
+	}
+
+	return countFreeColors(reserved.bitmap, clampVals);
+
+}
+
+const LuminanceIndex &Generator::luminanceIndex(const short *clampVals) {
+
+	if (!index || !std::equal(clampVals, clampVals + 6, indexClamp)) {
+		index = std::make_shared<const LuminanceIndex>(reserved.bitmap, clampVals);
+		std::copy(clampVals, clampVals + 6, indexClamp);
+	}
+
+	return *index;
+
+}
+
+void Generator::generate(MutableColorSpan out, const GenerateOptions &options) {
+
+	short clampVals[6];
+	std::copy(options.clampVals, options.clampVals + 6, clampVals);
+
+	for (int c = 0; c < 3; c++) {
+		if (clampVals[c] < 0 || clampVals[c + 3] > 255 || clampVals[c] > clampVals[c + 3])
+			throw std::runtime_error("Clamp values must lie in 0-255 with each minimum at most its maximum.");
+	}
+
+	bool band = options.minLuminance > 0 || options.maxLuminance < 255;
+
+	if (options.minLuminance < 0 || options.maxLuminance > 255 || options.minLuminance > options.maxLuminance)
+		throw std::runtime_error("Luminance bounds must lie in 0-255 with the minimum at most the maximum.");
+
+	if (band && options.minDeltaE > 0)
+		throw std::runtime_error("A luminance band cannot be combined with a minimum delta E.");
+
+	if (options.seeded && (band || options.minDeltaE > 0))
+		throw std::runtime_error("Seeded order cannot be combined with a luminance band or a minimum delta E.");
+
+	if (out.size == 0)
+		return;
+
+	std::unique_ptr<ColorBitmap> constrained;
+
+	if (!options.regions.empty() || !options.excludedRegions.empty())
+		constrained.reset(new ColorBitmap(constrainReserved(reserved.bitmap, options.regions, options.excludedRegions)));
+
+	const ColorBitmap &available = constrained ? *constrained : reserved.bitmap;
+
+	if (band) {
+
+		/* The cached index only knows the reserved set, so a region request indexes its own bitmap. */
+
+		ColorList values = constrained
+			? LuminanceIndex(available, clampVals).take(options.minLuminance, options.maxLuminance, (long)out.size, options.mContrast)
+			: luminanceIndex(clampVals).take(options.minLuminance, options.maxLuminance, (long)out.size, options.mContrast, &reserved.bitmap);
+
+		if (values.size() < out.size)
+			throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(values.size()) + " meet the constraints.");
+
+		std::copy(values.begin(), values.end(), out.data);
+
+	}
+	else if (options.seeded) {
+
+		ColorList values = generateSeededValues(available, (long)out.size, options.mContrast, clampVals, options.seed);
+		std::copy(values.begin(), values.end(), out.data);
+
+	}
+	else if (options.mContrast <= 1 && options.minDeltaE <= 0 && !constrained) {
+
+		/* Unconstrained: scan on from where the last request in the same clamp box stopped. A request that fails leaves the cursor as it was. */
+
+		unsigned int cursor = std::equal(clampVals, clampVals + 6, cursorClamp) ? rowCursor : 0;
+		size_t taken = takeFreeColors(reserved.bitmap, clampVals, cursor, out.size, out.data);
+
+		if (taken < out.size)
+			throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(countFreeColors(reserved.bitmap, clampVals)) + " unreserved colors exist in the clamped range.");
+
+		std::copy(clampVals, clampVals + 6, cursorClamp);
+		rowCursor = cursor;
+
+	}
+	else {
+
+		ColorList values = options.minDeltaE > 0
+			? generatePerceptualValues(available, (long)out.size, options.minDeltaE, clampVals)
+			: generateShardedValues(available, (long)out.size, options.mContrast, clampVals, std::max(options.threads, 1u));
+
+		std::copy(values.begin(), values.end(), out.data);
+
+	}
+
+	if (options.sort && !band) {
+		ColorList sorted(out.data, out.data + out.size);
+		luminanceSort(sorted);
+		std::copy(sorted.begin(), sorted.end(), out.data);
+	}
+
+	reserve(ColorSpan(out.data, out.size));
+
+}
+
+ColorList Generator::generate(size_t count, const GenerateOptions &options) {
+
+	ColorList values(count);
+	generate(MutableColorSpan(values), options);
+
+	return values;
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "generator_f.h"
+#include "sources_f.h"
+#include "province_map_f.h"
+#include "luminance_index_f.h"
+#include "allocator_f.h"
+#include "permutation_f.h"
+#include "region_f.h"
+
+#include <memory>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Public library interface of the Clausewitz Color Factory.
+
+ColorSpan and MutableColorSpan are non-owning views of packed colors (std::span is C++20; the project builds as C++17).
+GenerateOptions carries the same generation settings as the command line. The defaults hand out free colors in RGB order with no constraints.
+
+Generator holds a reserved bitmap across calls, loaded from one definition.csv or merged from several files and directories (see sources_f.h). Every color it generates is reserved before it is returned, so successive calls
+never repeat a color. With default options a request is served by bit scans from a cursor that remembers where the last one stopped,
+so asking for a single fresh color takes microseconds. Constrained requests go through the same engines as the command line.
+With seeded set, colors come in the ColorPermutation order of permutation_f.h for seed; every request walks that order from the start and skips what is already reserved.
+regions and excludedRegions restrict a request to region specs (region_f.h); such requests are generated against a copy of the reserved bitmap with the regions folded in.
+A luminance band narrower than 0-255 is served darkest first from a LuminanceIndex that is built on first use and kept until colors are released
+or the clamp box changes; colors reserved since it was built are skipped.
+Generator is not thread-safe. Threads that must share one pool of colors should use ColorAllocator (allocator_f.h), built from reservedBitmap().
+All methods report failure by throwing std::runtime_error. Call setProgressOutput(NULL) to keep the library quiet.
+*/
+
+struct ColorSpan {
+
+	const Color *data;
+	size_t size;
+
+	ColorSpan(const Color *data, size_t size) : data(data), size(size) {}
+	ColorSpan(const ColorList &colors) : data(colors.data()), size(colors.size()) {}
+
+};
+
+struct MutableColorSpan {
+
+	Color *data;
+	size_t size;
+
+	MutableColorSpan(Color *data, size_t size) : data(data), size(size) {}
+	MutableColorSpan(ColorList &colors) : data(colors.data()), size(colors.size()) {}
+
+};
+
+struct GenerateOptions {
+	short mContrast = 1;
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+	unsigned int threads = 1;
+	double minDeltaE = 0;
+	bool seeded = false;
+	uint64_t seed = 0;
+	short minLuminance = 0;
+	short maxLuminance = 255;
+	std::vector<std::string> regions;
+	std::vector<std::string> excludedRegions;
+	bool sort = false;
+};
+
+class Generator {
+
+public:
+
+	Generator();
+	explicit Generator(const std::string &definitionCsv, bool useCache = true);
+	explicit Generator(const std::vector<std::string> &definitionInputs, bool useCache = true);
+	explicit Generator(const ReservedSet &reserved);
+
+	void reserve(ColorSpan colors);
+	void release(ColorSpan colors);
+	void reserveProvinceMap(const std::string &provincesBmp);
+	bool isReserved(Color color) const { return reserved.bitmap.test(color); }
+
+	unsigned long available(const GenerateOptions &options = GenerateOptions()) const;
+
+	void generate(MutableColorSpan out, const GenerateOptions &options = GenerateOptions());
+	ColorList generate(size_t count, const GenerateOptions &options = GenerateOptions());
+
+	const ColorBitmap &reservedBitmap() const { return reserved.bitmap; }
+	unsigned long provinceCount() const { return reserved.provinceCount; }
+	long maxProvinceId() const { return reserved.maxProvinceId; }
+
+private:
+
+	const LuminanceIndex &luminanceIndex(const short *clampVals);
+
+	ReservedSet reserved;
+	std::shared_ptr<const LuminanceIndex> index;	// Band index, shared by copies since it is never modified.
+	short indexClamp[6];			// Clamp box index was built for.
+	unsigned int rowCursor;			// Row where the last unconstrained request stopped.
+	short cursorClamp[6];			// Clamp box rowCursor belongs to.
+
+};
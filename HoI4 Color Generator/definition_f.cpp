@@ -0,0 +1,151 @@
+#include "definition_f.h"
+#include "mapped_file_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*Parse semicolon-separated integer fields straight out of the mapped file.*/
+
+const char *parseDefinitionFields(const char *line, const char *lineEnd, long *fields, int fieldCount) {
+
+	const char *cursor = line;
+
+	for (int i = 0; i < fieldCount; i++) {
+
+		while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t'))
+			cursor++;
+
+		if (cursor == lineEnd)
+			return "too few fields";
+
+		bool negative = false;
+
+		if (*cursor == '-') {
+			negative = true;
+			cursor++;
+		}
+
+		if (cursor == lineEnd || *cursor < '0' || *cursor > '9')
+			return "expected a number";
+
+		long value = 0;
+
+		while (cursor < lineEnd && *cursor >= '0' && *cursor <= '9') {
+			if (value < 100000000)
+				value = value * 10 + (*cursor - '0');
+			cursor++;
+		}
+
+		while (cursor < lineEnd && (*cursor == ' ' || *cursor == '\t'))
+			cursor++;
+
+		/* The last field we need may end the line; every other one must be followed by a separator. */
+
+		if (cursor < lineEnd && *cursor != ';')
+			return "expected a number";
+		if (cursor == lineEnd && i < fieldCount - 1)
+			return "too few fields";
+
+		fields[i] = negative ? -value : value;
+		cursor++;
+
+	}
+
+	return NULL;
+
+}
+
+/*
+	Parse definition.csv rows held in memory, numbering lines from firstLine.
+	Each row yields its second, third, and fourth semicolon-separated values as one packed color.
+	Blank lines and comments are skipped, as is a header row on line 1 (EU4 ships one). Any other malformed row throws, naming its line number.
+*/
+
+unsigned long parseDefinitionText(const char *begin, const char *end, const std::string &csv, unsigned long firstLine, ColorList &values, long &maxProvinceId) {
+
+	const char *cursor = begin;
+	unsigned long lineNumber = firstLine - 1;
+
+	/* Skip a UTF-8 byte order mark. */
+
+	if (firstLine == 1 && end - cursor >= 3 && memcmp(cursor, "\xEF\xBB\xBF", 3) == 0)
+		cursor += 3;
+
+	values.reserve(values.size() + (end - begin) / 24);
+
+	while (cursor < end) {
+
+		const char *lineEnd = (const char *)memchr(cursor, '\n', end - cursor);
+		if (lineEnd == NULL)
+			lineEnd = end;
+
+		const char *line = cursor;
+		cursor = lineEnd < end ? lineEnd + 1 : end;
+		lineNumber++;
+
+		if (lineEnd > line && lineEnd[-1] == '\r')
+			lineEnd--;
+
+		if (line == lineEnd || *line == '#')
+			continue;
+
+		long fields[4];
+		const char *error = parseDefinitionFields(line, lineEnd, fields, 4);
+
+		if (error != NULL) {
+			if (lineNumber == 1 && (*line < '0' || *line > '9'))
+				continue;
+			throw std::runtime_error(csv + " line " + std::to_string(lineNumber) + ": " + error + ".");
+		}
+
+		for (int j = 1; j < 4; j++) {
+			if (fields[j] < 0 || fields[j] > 255)
+				throw std::runtime_error(csv + " line " + std::to_string(lineNumber) + ": color value " + std::to_string(fields[j]) + " is outside 0-255.");
+		}
+
+		values.push_back(packColor((unsigned int)fields[1], (unsigned int)fields[2], (unsigned int)fields[3]));
+		maxProvinceId = std::max(maxProvinceId, fields[0]);
+
+	}
+
+	return lineNumber - (firstLine - 1);
+
+}
+
+/*
+	Reads definition.csv files to find reserved values. The file is memory-mapped and scanned in place.
+	If maxProvinceId is given it receives the highest province ID in the file, or 0 if there are no rows.
+*/
+
+ColorList getReservedList(const std::string &csv, long *maxProvinceId) {
+
+	MappedFile definition(csv);
+	ColorList values;
+	long highestId = 0;
+
+	parseDefinitionText(definition.begin(), definition.end(), csv, 1, values, highestId);
+
+	if (maxProvinceId != NULL)
+		*maxProvinceId = highestId;
+
+	return values;
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+parseDefinitionFields reads the first fieldCount semicolon-separated integers of one definition.csv line in place, without copying.
+Returns NULL on success or a short description of what is wrong with the line.
+*/
+
+const char *parseDefinitionFields(const char *line, const char *lineEnd, long *fields, int fieldCount);
+
+/*
+parseDefinitionText parses definition.csv rows held in memory, numbering lines from firstLine so errors point at the right place.
+It appends one packed color per row to values, raises maxProvinceId to the highest province ID seen, and returns the number of lines read.
+*/
+
+unsigned long parseDefinitionText(const char *begin, const char *end, const std::string &csv, unsigned long firstLine, ColorList &values, long &maxProvinceId);
+
+ColorList getReservedList(const std::string &csv, long *maxProvinceId = NULL);
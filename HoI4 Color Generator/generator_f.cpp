@@ -1,4 +1,6 @@
 #include "generator_f.h"
+#include "luminance_f.h"
+#include "stats_f.h"
 
 /*
 Author: Derek Warter
@@ -21,41 +23,17 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see https://www.gnu.org/licenses/.
 */
 
-/*Reads description.csv files to find reserved values.*/
+/*Progress messages from the generators. A stream without a buffer swallows everything written to it.*/
 
-RGB getReservedList(std::string csv) {
+static std::ostream silentStream(NULL);
+static std::ostream *progressStream = &std::cout;
 
-	RGB values;
-	std::ifstream definition(csv);
-	unsigned int i = 0;
-
-	/*
-		Failsafe.
-	*/
-
-	if (definition.eof())
-		throw std::runtime_error("Cannot access description.csv. Please make sure the file is present in the executable directory.");
-
-	for (std::string line; std::getline(definition, line); ) {
-
-		/*
-			Read description.csv by taking second, third, and forth semicolon-separated values. Will fail if file is improperly formatted, but the correct file is supplied with the program.
-		*/
-
-		values.push_back(std::vector<std::string>());
-		line = line.substr(line.find_first_of(";") + 1);
-
-		for (unsigned int j = 0; j < 3; j++) {
-			values[i].push_back(line.substr(0, line.find_first_of(";")));
-			line = line.substr(line.find_first_of(";") + 1);
-		}
-
-		i++;
-
-	}
-
-	return values;
+void setProgressOutput(std::ostream *stream) {
+	progressStream = stream;
+}
 
+std::ostream &progressOutput() {
+	return progressStream != NULL ? *progressStream : silentStream;
 }
 
 /*Collects and validates user input. Very ugly function, but it does what it must.*/
@@ -127,7 +105,7 @@ void validateUserInput(long &pCount, short &contrast, short *clampVals, std::str
 	}
 
 	std::cout << "Would you like to sort the generated colors based upon brightness?" << std::endl;
-	std::cout << "(Significantly increases generation time!) (y/n): ";
+	std::cout << "(y/n): ";
 
 	while (true) {
 
@@ -162,304 +140,384 @@ double getContrast(unsigned short r, unsigned short g, unsigned short b) {
 	return (double)((299 * r + 587 * g + 114 * b) / 1000);
 }
 
-/*Generate map for reserved values so that the color generator can reject unacceptable outputs.*/
+double getContrast(Color color) {
+	return (double)getLuminance(color);
+}
+
+/*Count the colors present in the bitmap.*/
 
-std::unordered_map<std::string, std::string> hashReservedList(RGB values) {
+unsigned long ColorBitmap::count() const {
 
-	std::unordered_map<std::string, std::string> hashMap;
+	unsigned long total = 0;
 
-	for (unsigned long i = 0; i < values.size(); i++) {
-		std::string rgb = values[i][0] + values[i][1] + values[i][2];
-		hashMap[rgb] = rgb;
-	}
+	for (size_t i = 0; i < words.size(); i++)
+		total += popCount64(words[i]);
 
-	return hashMap;
+	return total;
 
 }
 
-/*Horribly inefficient means of sorting RGB values by luminance.
-Unfortunately merge sort and quicksort quickly overwhelm the callstack, and insertion sort does not offer much of an improvement.
-Given that most users will attempt to generate less than 1000 values, this is an acceptable algorithm.*/
+/*Add every color of other to the bitmap.*/
 
-void selectionRGBSort(RGB &values) {
+void ColorBitmap::merge(const ColorBitmap &other) {
 
-	std::cout << "Sorting colors by luminance..." << std::endl;
+	for (size_t i = 0; i < words.size(); i++)
+		words[i] |= other.words[i];
 
-	int size = values.size();
+}
 
-	for (int j = 0; j < size - 1; j++) {
+/*Keep only the colors also in other.*/
 
-		int iMin = j;
+void ColorBitmap::intersect(const ColorBitmap &other) {
 
-		for (int i = j + 1; i < size; i++) {
+	for (size_t i = 0; i < words.size(); i++)
+		words[i] &= other.words[i];
 
-			std::vector<std::string> compTarget = values[i];
-			std::vector<std::string> assumedLowest = values[iMin];
-			unsigned short ctR = (unsigned short)std::stoi(compTarget[0]);
-			unsigned short ctG = (unsigned short)std::stoi(compTarget[1]);
-			unsigned short ctB = (unsigned short)std::stoi(compTarget[2]);
-			unsigned short alR = (unsigned short)std::stoi(assumedLowest[0]);
-			unsigned short alG = (unsigned short)std::stoi(assumedLowest[1]);
-			unsigned short alB = (unsigned short)std::stoi(assumedLowest[2]);
+}
 
-			if (getContrast(ctR, ctG, ctB) < getContrast(alR, alG, alB))
-				iMin = i;
-			
+/*Remove every color of other from the bitmap.*/
 
-		}
+void ColorBitmap::subtract(const ColorBitmap &other) {
 
-		if (iMin != j) {
-			std::vector<std::string> temp = values[j];
-			values[j] = values[iMin];
-			values[iMin] = temp;
-		}
+	for (size_t i = 0; i < words.size(); i++)
+		words[i] &= ~other.words[i];
 
-		int percent = ((double)j / (double)(size - 2)) * 100;
-		std::cout << percent << "%\r" << std::flush;
+}
 
-	}
+void ColorBitmap::invert() {
+
+	for (size_t i = 0; i < words.size(); i++)
+		words[i] = ~words[i];
+
+}
+
+/*Generate bitmap for reserved values so that the color generator can reject unacceptable outputs.*/
+
+ColorBitmap hashReservedList(const ColorList &values) {
+
+	ColorBitmap reserved;
+
+	for (unsigned long i = 0; i < values.size(); i++)
+		reserved.set(values[i]);
+
+	return reserved;
 
 }
 
 /*
-	Combinatorial method of generating original color values.
-	This functions by stepping through color values similarly to, but not exactly like, an odomoter.
-	Starts with red values, then blue values, then green values.
-	Each time the odometer "completes" a cycle of 768 colors, returns to red and increases other colors by a set amount.
-	This ensures that every possible color in the gamut can be generated.
-	generateUnreservedValues can reject a color that the odometer generates if it is reserved or already generated.
+	Sort colors by luminance with a stable counting sort.
+	getContrast yields an integer from 0 to 255, so one pass counts each key, a prefix sum turns counts into offsets, and a second pass scatters colors into place.
+	Runs in linear time without recursion, and colors of equal luminance keep their generated order.
+	Keys are computed up front in one batchLuminance call.
 */
 
-void colorOdometer(unsigned short &r, unsigned short &g, unsigned short &b, int step, short *clampVals, unsigned short &min, unsigned short &colorTurn, bool &justTurned) {
+void luminanceSort(ColorList &values) {
 
-	switch (colorTurn) {
-	case 0:
-		if (r == (clampVals[0] + min) && justTurned) {
-			r = clampVals[0];
-			justTurned = false;
-		}
-		if (r < clampVals[3]) {
-			r = std::min(r + step, (int)clampVals[3]);
-			b = clampVals[2] + min;
-			g = clampVals[1] + min;
-		}
-		else {
-			colorTurn++;
-			r = clampVals[0] + min;
-			justTurned = true;
-		}
-		break;
-	case 1:
-		if (g == (clampVals[1] + min) && justTurned) {
-			g = clampVals[1];
-			justTurned = false;
-		}
-		if (g < clampVals[4]) {
-			g = std::min(g + step, (int)clampVals[4]);
-			r = clampVals[0] + min;
-			b = clampVals[2] + min;
-		}
-		else {
-			colorTurn++; g = clampVals[1] + min;
-			justTurned = true;
-		}
-		break;
-	case 2:
-		if (b == (clampVals[2] + min) && justTurned) {
-			b = clampVals[2];
-			justTurned = false;
-		}
-		if (b < clampVals[5]) {
-			b = std::min(b + step, (int)clampVals[5]);
-			r = clampVals[0] + min;
-			g = clampVals[1] + min;
-		}
-		else {
-			colorTurn = 0; min += step;
-			r = clampVals[0];
-			g = clampVals[1] + min;
-			b = clampVals[2] + min;
-			justTurned = true;
+	progressOutput() << "Sorting colors by luminance..." << std::endl;
+
+	std::vector<unsigned char> keys(values.size());
+	unsigned long offsets[257] = { 0 };
+
+	batchLuminance(values.data(), values.size(), keys.data());
+
+	for (unsigned long i = 0; i < values.size(); i++)
+		offsets[keys[i] + 1]++;
+
+	for (int key = 0; key < 256; key++)
+		offsets[key + 1] += offsets[key];
+
+	ColorList sorted(values.size());
+
+	for (unsigned long i = 0; i < values.size(); i++)
+		sorted[offsets[keys[i]]++] = values[i];
+
+	values.swap(sorted);
+
+}
+
+/*Count the unreserved colors inside the clamped cube with one popcount per bitmap word.*/
+
+unsigned long countFreeColors(const ColorBitmap &reserved, short *clampVals) {
+
+	unsigned long total = 0;
+	uint64_t mask[4];
+
+	for (int r = clampVals[0]; r <= clampVals[3]; r++) {
+		for (int g = clampVals[1]; g <= clampVals[4]; g++) {
+			freeRowMask(reserved, r, g, clampVals, mask);
+			total += popCount64(mask[0]) + popCount64(mask[1]) + popCount64(mask[2]) + popCount64(mask[3]);
 		}
-		break;
 	}
 
+	return total;
+
 }
 
-RGB generateUnreservedValues(std::unordered_map<std::string, std::string> hashMap, long pCount, short mContrast, short *clampVals) {
+/*
+	Copy up to count free colors of the clamped cube into out, in packed order, starting at the (red << 8 | green) row in rowCursor.
+	rowCursor is left on the row of the last color taken (it may still hold free colors), or past the cube when it runs out.
+	The bitmap is not changed; callers that hand the colors out mark them themselves.
+*/
+
+size_t takeFreeColors(const ColorBitmap &reserved, short *clampVals, unsigned int &rowCursor, size_t count, Color *out) {
+
+	size_t taken = 0;
+	uint64_t mask[4];
+	int r = std::max((int)(rowCursor >> 8), (int)clampVals[0]);
+	int g = r == (int)(rowCursor >> 8) ? std::max((int)(rowCursor & 0xff), (int)clampVals[1]) : clampVals[1];
+
+	for (; r <= clampVals[3]; r++, g = clampVals[1]) {
+		for (; g <= clampVals[4]; g++) {
+
+			freeRowMask(reserved, r, g, clampVals, mask);
+
+			for (int w = 0; w < 4; w++) {
+				for (uint64_t bits = mask[w]; bits != 0 && taken < count; bits &= bits - 1)
+					out[taken++] = packColor(r, g, 64 * w + lowestBit64(bits));
+			}
+
+			if (taken == count) {
+				rowCursor = (unsigned int)((r << 8) | g);
+				return taken;
+			}
 
-	RGB newValues;											// Unreserved color values to generate.
+		}
+	}
 
-	long i = 0;												// How many colors have been successfully generated? Stop when we generate the number of colors the user wants.
-	long timeout = 0;										// Stop if timeout value exceeds MAX_VALUES_TO_ATTEMPT.
-	unsigned short min = 0;									// Helps the color odometer update each time a cycle is completed.
-	unsigned short colorTurn = 0;							// Which color is being focused upon? 0 = red, 1 = green, 2 = blue.
-	bool justTurned = true;									// Did the odometer just turn over?
-	unsigned short r = clampVals[0] + min;					// Starting r value (clamped to user-set minimum).
-	unsigned short g = clampVals[1] + min;					// Starting b value (clamped to user-set minimum).
-	unsigned short b = clampVals[2] + min;					// Starting c value (clamped to user-set minimum).
-	std::unordered_map<std::string, std::string> noDupes;	// Ensures that no duplicate colors are generated by the odometer in the case that the user has clamped colors/set a high minimum contrast.
-	double previousContrast = 0;							// Store the luminance value of the previously accepted RGB value. If the next generated value is too close to the old one, then reject it until we reach an acceptable level of contrast.
-	std::cout << "Generating unreserved colors..." << std::endl;
+	rowCursor = 0x10000;
+	return taken;
 
-	while (i < pCount) {
+}
 
-		/* Get the contrast of the current color values. Determine how much the rgb values need to be changed based on difference between luminances. */
+/*
+	Enumerate free colors of one red shard of the clamped cube in packed order, keeping those that satisfy the minimum contrast.
+	Free colors come straight out of the row masks by bit scans, so reserved colors are never visited; they are counted from the masks instead.
+	A contrast above 1 is measured against the last color accepted, starting from lastLuminance (-1 for none), so with the default every shard
+	can be scanned on its own. Each green row gets its luminance from one batchLuminance call.
+	With converge, the scan stops at the first accepted color that converge also holds and finishes with the rest of converge: from a common color
+	on, two contrast chains over the same free colors accept the same ones.
+*/
 
-		double curContrast = std::abs(getContrast(r, g, b) - previousContrast);
-		int desiredContrastStep = std::max((int)(mContrast - curContrast), 1);
+static ColorList generateShard(const ColorBitmap &reserved, unsigned short r, long pCount, short mContrast, short *clampVals, GenerationCounters &counters,
+	int lastLuminance = -1, const ColorList *converge = NULL) {
 
-		colorOdometer(r, g, b, desiredContrastStep, clampVals, min, colorTurn, justTurned);
+	ColorList shard;
+	Color row[256];
+	unsigned char rowLuminance[256];
+	uint64_t mask[4];
+	size_t match = 0;
+	int width = clampVals[5] - clampVals[2] + 1;
 
-		/* Concatenate color values into string key that can be compared against hashes. */
+	for (int g = clampVals[1]; g <= clampVals[4] && (long)shard.size() < pCount; g++) {
 
-		std::string rs = std::to_string(r);
-		std::string gs = std::to_string(g);
-		std::string bs = std::to_string(b);
-		std::string concateRGB = rs + gs + bs;
+		freeRowMask(reserved, r, g, clampVals, mask);
 
-		if (hashMap.find(concateRGB) == hashMap.end() && noDupes.find(concateRGB) == noDupes.end()) {
+		int rowFree = popCount64(mask[0]) + popCount64(mask[1]) + popCount64(mask[2]) + popCount64(mask[3]);
+		int rowVisited = 0;
+		int b = clampVals[2];
 
-			/*If key matches neither hash for reserved values or hash for accepted values, then add current rgb values to newValues RGB vector.*/
+		if (rowFree == 0) {
+			counters.examined += width;
+			counters.rejectedReserved += width;
+			continue;
+		}
 
-			newValues.push_back(std::vector<std::string>());
-			newValues[i].push_back(rs);
-			newValues[i].push_back(gs);
-			newValues[i].push_back(bs);
-			i++;
-			previousContrast = curContrast;
-			int percent = (((double)i / (double)(pCount - 1)) * 100);
-			std::cout << percent << "%\r" << std::flush;
-			noDupes[concateRGB] = concateRGB;
+		if (mContrast > 1) {
+			for (int blue = 0; blue < 256; blue++)
+				row[blue] = packColor(r, g, blue);
+			batchLuminance(row, 256, rowLuminance);
 		}
 
-		timeout++;
+		for (int w = 0; w < 4 && (long)shard.size() < pCount; w++) {
+
+			uint64_t bits = mask[w];
+
+			while (bits != 0 && (long)shard.size() < pCount) {
+
+				b = 64 * w + lowestBit64(bits);
+				bits &= bits - 1;
+				rowVisited++;
+
+				if (mContrast > 1) {
+					if (lastLuminance >= 0 && std::abs(rowLuminance[b] - lastLuminance) < mContrast) {
+						counters.rejectedContrast++;
+						continue;
+					}
+					lastLuminance = rowLuminance[b];
+				}
+
+				shard.push_back(packColor(r, g, b));
+
+				if (converge != NULL) {
+					while (match < converge->size() && (*converge)[match] < shard.back())
+						match++;
+					if (match < converge->size() && (*converge)[match] == shard.back()) {
+						long take = std::min((long)(converge->size() - match - 1), pCount - (long)shard.size());
+						shard.insert(shard.end(), converge->begin() + match + 1, converge->begin() + match + 1 + take);
+						counters.accepted += shard.size();
+						return shard;
+					}
+				}
+
+			}
+
+		}
 
-		if (timeout > MAX_VALUES_TO_ATTEMPT)
-			throw std::runtime_error("Could not generate requested colors.");
+		/* A row cut short by pCount was only examined up to the last blue visited. */
 
+		int examined = rowVisited == rowFree ? width : b - clampVals[2] + 1;
+		counters.examined += examined;
+		counters.rejectedReserved += examined - rowVisited;
 
 	}
 
-	return newValues;
+	counters.accepted += shard.size();
 
-}
+	return shard;
 
-/*Convert integer RGB values to hex codes.*/
-/*https://stackoverflow.com/questions/14375156/how-to-convert-a-rgb-color-value-to-an-hexadecimal-value-in-c*/
+}
 
-unsigned long toRGB(std::vector<std::string> color) {
+/*
+	Closed-form generation: the free set is the clamped cube minus the reserved bitmap, enumerated in packed (red, green, blue) order.
+	The free set is counted first, so a request larger than it fails at once with the exact number available.
+	Identical to generateShardedValues on any number of threads.
+*/
 
-	int r = std::stoi(color[0]);
-	int g = std::stoi(color[1]);
-	int b = std::stoi(color[2]);
+ColorList generateUnreservedValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals) {
 
-	return ((r & 0xff) << 16) + ((g & 0xff) << 8) + (b & 0xff);
+	return generateShardedValues(reserved, pCount, mContrast, clampVals, 1);
 
 }
 
-/*Convert RGB vector to text file.*/
+/*
+	Parallel form of generateUnreservedValues.
+	The clamped cube is split into one shard per red value. Worker threads claim shards in order and filter them independently against the reserved bitmap.
+	Shards are then concatenated in red order and cut at pCount, so the output is identical for any thread count.
+	Workers stop claiming shards once the finished shards ahead of them already hold pCount colors.
+	With a contrast above 1 each shard was scanned as if it began the list, so the merge rescans it from the last color merged until the two contrast
+	chains meet (usually within a few colors) and keeps the shard from there. Shards skipped by the workers are scanned at the merge.
+	The result is the single pass over the whole box, and the counters are those of the independent scans.
+*/
+
+ColorList generateShardedValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals, unsigned int threads) {
+
+	int shardCount = clampVals[3] - clampVals[0] + 1;
+	std::vector<ColorList> shards(shardCount);
+	std::vector<bool> finished(shardCount, false);
+	std::atomic<int> nextShard(0);
+	std::mutex progress;
+	GenerationCounters counters;
+	ProgressMeter meter(shardCount);
+	unsigned long available = countFreeColors(reserved, clampVals);
 
-void RGBToText(RGB values) {
+	if ((unsigned long)pCount > available)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(available) + " unreserved colors exist in the clamped range.");
 
-	std::ofstream outText("unreserved.txt");
+	if (threads > 1)
+		progressOutput() << "Generating unreserved colors on " << threads << " threads..." << std::endl;
+	else
+		progressOutput() << "Generating unreserved colors..." << std::endl;
 
-	if (outText) {
+	auto worker = [&]() {
 
-		outText << "(R, G, B)" << std::endl;
+		while (true) {
+
+			int shard = nextShard++;
+
+			if (shard >= shardCount)
+				return;
+
+			/* Skip the shard if every shard before it is finished and together they already cover the request. */
+
+			{
+				std::lock_guard<std::mutex> lock(progress);
+				long covered = 0;
+				int i = 0;
+				while (i < shard && finished[i] && covered < pCount) {
+					covered += shards[i].size();
+					i++;
+				}
+				if (covered >= pCount)
+					return;
+			}
+
+			GenerationCounters shardCounters;
+			ColorList values = generateShard(reserved, (unsigned short)(clampVals[0] + shard), pCount, mContrast, clampVals, shardCounters);
+
+			std::lock_guard<std::mutex> lock(progress);
+			shards[shard].swap(values);
+			finished[shard] = true;
+			counters += shardCounters;
+			meter.advance();
 
-		for (unsigned long i = 0; i < values.size(); i++) {
-			unsigned long hex = toRGB(values[i]);
-			outText << "(" << values[i][0] << ", " << values[i][1] << ", " << values[i][2] << ") " << std::hex << hex << std::endl;
 		}
 
-	}
+	};
 
-	outText.close();
+	std::vector<std::thread> pool;
 
-}
+	for (unsigned int i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
 
-/*Get smallest 1:1 image size to contain all generated values.*/
-/*Consider starting at numColors and then decrementing until we find a value with a root.*/
+	worker();
 
-int squarePalette(int numColors) {
+	for (unsigned int i = 0; i < pool.size(); i++)
+		pool[i].join();
 
-	int i = 1;
+	/* Deterministic merge: concatenate shards in red order. */
 
-	while (i * i < numColors) {
-		i++;
-	}
+	ColorList newValues;
+	newValues.reserve(pCount);
 
-	return i;
+	for (int i = 0; i < shardCount && (long)newValues.size() < pCount; i++) {
 
-}
+		long remaining = pCount - (long)newValues.size();
+		unsigned short r = (unsigned short)(clampVals[0] + i);
+		int lastLuminance = mContrast > 1 && !newValues.empty() ? getLuminance(newValues.back()) : -1;
+		GenerationCounters seamCounters;
 
-/*https://stackoverflow.com/questions/2654480/writing-bmp-image-in-pure-c-c-without-other-libraries*/
-
-void RGBToBMP(RGB values, int squaredColors) {
-
-	FILE *outImg;
-	unsigned char *img = NULL;
-	int filesize = 54 + 3 * squaredColors * squaredColors;
-
-	img = (unsigned char *)malloc(3 * squaredColors * squaredColors);
-	memset(img, 0, 3 * squaredColors * squaredColors);
-	int pixel = 0; // Since we're taking from a 2d vector where each column is a complete RGB value,
-				   // we simply want to increment one value to get the color.
-				   // The nested loop controls where that color goes.
-
-	for (int w = 0; w < squaredColors; w++) {
-		for (int h = 0; h < squaredColors; h++) {
-			int x = w; int y = (squaredColors - 1) - h;
-			int r;
-			int g;
-			int b;
-			if (pixel >= values.size()) {
-				r = 255;
-				g = 255;
-				b = 255;
-			}
-			else {
-				r = std::stoi(values[pixel][0]);
-				g = std::stoi(values[pixel][1]);
-				b = std::stoi(values[pixel][2]);
-				pixel++;
-			}
-			img[(x + y * squaredColors) * 3 + 2] = (unsigned char)(r);
-			img[(x + y * squaredColors) * 3 + 1] = (unsigned char)(g);
-			img[(x + y * squaredColors) * 3 + 0] = (unsigned char)(b);
+		if (!finished[i]) {
+			shards[i] = generateShard(reserved, r, remaining, mContrast, clampVals, counters, lastLuminance);
 		}
+		else if (lastLuminance >= 0) {
+			ColorList seam = generateShard(reserved, r, remaining, mContrast, clampVals, seamCounters, lastLuminance, &shards[i]);
+			if ((long)seam.size() < remaining && (long)shards[i].size() >= pCount)
+				seam = generateShard(reserved, r, remaining, mContrast, clampVals, seamCounters, lastLuminance);
+			/* The rescan replaces the shard, so its colors replace the shard's in the count (which may go down). */
+			counters.accepted -= shards[i].size();
+			counters.accepted += seam.size();
+			shards[i].swap(seam);
+		}
+
+		long take = std::min((long)shards[i].size(), remaining);
+		newValues.insert(newValues.end(), shards[i].begin(), shards[i].begin() + take);
+
 	}
 
-	unsigned char bmpfileheader[14] = { 'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0 };
-	unsigned char bmpinfoheader[40] = { 40,0,0,0, 0,0,0,0, 0,0,0,0, 1,0, 24,0 };
-	unsigned char bmppad[3] = { 0,0,0 };
+	/* Shard counters count everything a shard accepted; whatever the merge cut off is surplus. */
+
+	counters.surplus = counters.accepted - newValues.size();
+	counters.accepted = newValues.size();
+	recordCounters(counters);
 
-	bmpfileheader[2] = (unsigned char)(filesize);
-	bmpfileheader[3] = (unsigned char)(filesize >> 8);
-	bmpfileheader[4] = (unsigned char)(filesize >> 16);
-	bmpfileheader[5] = (unsigned char)(filesize >> 24);
+	if ((long)newValues.size() < pCount)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(newValues.size()) + " meet the constraints.");
 
-	bmpinfoheader[4] = (unsigned char)(squaredColors);
-	bmpinfoheader[5] = (unsigned char)(squaredColors >> 8);
-	bmpinfoheader[6] = (unsigned char)(squaredColors >> 16);
-	bmpinfoheader[7] = (unsigned char)(squaredColors >> 24);
-	bmpinfoheader[8] = (unsigned char)(squaredColors);
-	bmpinfoheader[9] = (unsigned char)(squaredColors >> 8);
-	bmpinfoheader[10] = (unsigned char)(squaredColors >> 16);
-	bmpinfoheader[11] = (unsigned char)(squaredColors >> 24);
+	return newValues;
 
+}
 
-	errno_t err = fopen_s(&outImg, "unreserved.bmp", "wb");
-	fwrite(bmpfileheader, 1, 14, outImg);
-	fwrite(bmpinfoheader, 1, 40, outImg);
+/*Get smallest 1:1 image size to contain all generated values.*/
+/*Consider starting at numColors and then decrementing until we find a value with a root.*/
 
-	for (int i = 0; i < squaredColors; i++) {
-		fwrite(img + (squaredColors*(squaredColors - i - 1) * 3), 3, squaredColors, outImg);
-		fwrite(bmppad, 1, (4 - (squaredColors * 3) % 4) % 4, outImg);
+int squarePalette(int numColors) {
+
+	int i = 1;
+
+	while (i * i < numColors) {
+		i++;
 	}
 
-	free(img);
-	fclose(outImg);
+	return i;
 
 }
@@ -5,9 +5,15 @@
 #include <fstream>
 #include <vector>
 #include <string>
-#include <unordered_map>
 #include <cmath>
 #include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
 #include <math.h>
 
 /*
@@ -32,33 +38,106 @@ along with this program.  If not, see https://www.gnu.org/licenses/.
 */
 
 /*
-RGB type is a 2d vector containing an R, G, and B value in each column.
-MAX_VALUES_TO_GENERATE limits the number of colors the user is allowed to generate. Can be safely changed, but attempting to generate too many values will induce slowdown.
-MAX_VALUES_TO_ATTEMPT limits number of generation attempts to the size of the 24-bit RGB spectrum. Changing this could cause unexpected behavior.
+Color type is a packed 24-bit value laid out as 0x00RRGGBB. The packed value doubles as the color's hex code.
+ColorList type is a contiguous list of packed colors. Strings only appear when colors are written to disk.
+MAX_VALUES_TO_GENERATE limits the number of colors generated into a ColorList (the prompts, sorting, delta E, luminance bands and the server). Larger counts go through ColorStream.
+COLOR_SPACE_SIZE is the number of colors in the 24-bit RGB spectrum.
 */
 
-typedef std::vector<std::vector<std::string> > RGB;
+typedef uint32_t Color;
+typedef std::vector<Color> ColorList;
 const int MAX_VALUES_TO_GENERATE = 50000;
-const int MAX_VALUES_TO_ATTEMPT = 16777216;
+const int COLOR_SPACE_SIZE = 16777216;
 
-RGB getReservedList(std::string csv);
+/*Bit helpers for 64-bit bitmap words.*/
+
+#ifdef _MSC_VER
+#include <intrin.h>
+inline int popCount64(uint64_t word) { return (int)__popcnt64(word); }
+inline int lowestBit64(uint64_t word) { unsigned long index; _BitScanForward64(&index, word); return (int)index; }
+#else
+inline int popCount64(uint64_t word) { return __builtin_popcountll(word); }
+inline int lowestBit64(uint64_t word) { return __builtin_ctzll(word); }
+#endif
+
+/*
+ColorBitmap holds one bit per color in the 24-bit spectrum (2 MiB), indexed by the packed color value.
+Membership is a single bit test, so the same structure serves as the reserved set and the already-generated set.
+merge, intersect, subtract and invert are the set operations OR, AND, AND NOT and NOT, one plain loop over the words each so the compiler can vectorize them.
+*/
+
+struct ColorBitmap {
+
+	std::vector<uint64_t> words;
+
+	ColorBitmap() : words(COLOR_SPACE_SIZE / 64, 0) {}
+
+	bool test(Color color) const { return ((words[color >> 6] >> (color & 63)) & 1) != 0; }
+	void set(Color color) { words[color >> 6] |= (uint64_t)1 << (color & 63); }
+	void reset(Color color) { words[color >> 6] &= ~((uint64_t)1 << (color & 63)); }
+
+	unsigned long count() const;
+	void merge(const ColorBitmap &other);
+	void intersect(const ColorBitmap &other);
+	void subtract(const ColorBitmap &other);
+	void invert();
+
+};
+
+inline Color packColor(unsigned int r, unsigned int g, unsigned int b) {
+	return ((r & 0xff) << 16) | ((g & 0xff) << 8) | (b & 0xff);
+}
+
+inline unsigned short redOf(Color color) { return (unsigned short)((color >> 16) & 0xff); }
+inline unsigned short greenOf(Color color) { return (unsigned short)((color >> 8) & 0xff); }
+inline unsigned short blueOf(Color color) { return (unsigned short)(color & 0xff); }
+
+/*Integer luminance (0-255) of a packed color. Same weighting as getContrast.*/
+
+inline unsigned short getLuminance(Color color) {
+	return (unsigned short)((299 * redOf(color) + 587 * greenOf(color) + 114 * blueOf(color)) / 1000);
+}
+
+/*
+Free colors of one (red, green) row of the clamped cube, as a 256-bit mask over blue.
+The row's 256 bits are four consecutive bitmap words, so the mask is the clamp range ANDed with the complement of the reserved words.
+*/
+
+inline void freeRowMask(const ColorBitmap &reserved, unsigned int r, unsigned int g, const short *clampVals, uint64_t mask[4]) {
+
+	size_t base = ((size_t)r << 10) | ((size_t)g << 2);
+
+	for (int w = 0; w < 4; w++) {
+		int low = std::max(clampVals[2] - 64 * w, 0);
+		int high = std::min(clampVals[5] - 64 * w, 63);
+		uint64_t range = low > high ? 0 : (~(uint64_t)0 >> (63 - high)) & (~(uint64_t)0 << low);
+		mask[w] = range & ~reserved.words[base + w];
+	}
+
+}
+
+/*Progress messages from the generators go to progressOutput, std::cout by default. setProgressOutput(NULL) silences them.*/
+
+void setProgressOutput(std::ostream *stream);
+
+std::ostream &progressOutput();
 
 void validateUserInput(long &pCount, short &contrast, short *clampVals, std::string &confirm);
 
 double getContrast(unsigned short r, unsigned short g, unsigned short b);
 
-std::unordered_map<std::string, std::string> hashReservedList(RGB values);
+double getContrast(Color color);
 
-void selectionRGBSort(RGB &values);
+ColorBitmap hashReservedList(const ColorList &values);
 
-void colorOdometer(unsigned short &r, unsigned short &g, unsigned short &b, int step, short *clampVals, unsigned short &min, unsigned short &colorTurn, bool &justTurned);
+void luminanceSort(ColorList &values);
 
-RGB generateUnreservedValues(std::unordered_map<std::string, std::string> hashMap, long pCount, short mContrast, short *clampVals);
+unsigned long countFreeColors(const ColorBitmap &reserved, short *clampVals);
 
-unsigned long toRGB(std::vector<std::string> color);
+size_t takeFreeColors(const ColorBitmap &reserved, short *clampVals, unsigned int &rowCursor, size_t count, Color *out);
 
-void RGBToText(RGB values);
+ColorList generateUnreservedValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals);
 
-int squarePalette(int numColors);
+ColorList generateShardedValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals, unsigned int threads);
 
-void RGBToBMP(RGB values, int squaredColors);
+int squarePalette(int numColors);
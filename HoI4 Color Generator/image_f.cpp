@@ -0,0 +1,345 @@
+#include "image_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const size_t PNG_CHUNK_SIZE = 1 << 20;		// Bytes of deflate data per IDAT chunk.
+static const size_t STORED_BLOCK_LIMIT = 65535;		// Largest stored deflate block.
+static const size_t NO_OPEN_BLOCK = (size_t)-1;
+
+/*CRC-32 as used by PNG chunks, table built once.*/
+
+struct CrcTable {
+
+	uint32_t values[256];
+
+	CrcTable() {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			values[n] = c;
+		}
+	}
+
+};
+
+static uint32_t crc32(uint32_t crc, const unsigned char *bytes, size_t length) {
+
+	static const CrcTable table;
+
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++)
+		crc = table.values[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+	return ~crc;
+
+}
+
+static uint32_t adler32(uint32_t adler, const unsigned char *bytes, size_t length) {
+
+	uint32_t a = adler & 0xffff;
+	uint32_t b = adler >> 16;
+
+	/* 5552 is the longest run that cannot overflow before the modulo. */
+
+	while (length > 0) {
+		size_t run = std::min(length, (size_t)5552);
+		for (size_t i = 0; i < run; i++) {
+			a += bytes[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		bytes += run;
+		length -= run;
+	}
+
+	return (b << 16) | a;
+
+}
+
+static void putLittle32(unsigned char *out, uint32_t value) {
+	out[0] = (unsigned char)value;
+	out[1] = (unsigned char)(value >> 8);
+	out[2] = (unsigned char)(value >> 16);
+	out[3] = (unsigned char)(value >> 24);
+}
+
+static void putBig32(unsigned char *out, uint32_t value) {
+	out[0] = (unsigned char)(value >> 24);
+	out[1] = (unsigned char)(value >> 16);
+	out[2] = (unsigned char)(value >> 8);
+	out[3] = (unsigned char)value;
+}
+
+ImageFormat imageFormatForPath(const std::string &path) {
+
+	if (path.size() >= 4) {
+		std::string extension = path.substr(path.size() - 4);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == ".png")
+			return ImageFormat::Png;
+	}
+
+	return ImageFormat::Bmp;
+
+}
+
+ImageWriter::ImageWriter(const std::string &path, ImageFormat format, int width, int height)
+	: path(path), file(NULL), format(format), width(width), height(height), rowsWritten(0), rowFill(0), blockStart(NO_OPEN_BLOCK), adler(1) {
+
+	if (width < 1 || height < 1)
+		throw std::runtime_error("Image dimensions must be positive.");
+
+	/* BMP rows are padded to four bytes. PNG rows start with a filter byte. */
+
+	size_t rowBytes = format == ImageFormat::Bmp ? ((size_t)width * 3 + 3) & ~(size_t)3 : (size_t)width * 3 + 1;
+	uint64_t dataSize = (uint64_t)rowBytes * height;
+
+	if (format == ImageFormat::Bmp && dataSize + 54 > 0xFFFFFFFFu)
+		throw std::runtime_error("Image is too large for a BMP file. Use a .png path instead.");
+
+	row.assign(rowBytes, 0);
+
+	file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL)
+		throw std::runtime_error("Cannot write " + path + ".");
+
+	if (format == ImageFormat::Bmp) {
+
+		unsigned char header[54] = { 'B','M', 0,0,0,0, 0,0, 0,0, 54,0,0,0, 40,0,0,0 };
+		putLittle32(header + 2, (uint32_t)(54 + dataSize));
+		putLittle32(header + 18, (uint32_t)width);
+		putLittle32(header + 22, (uint32_t)-height);	// Negative: rows are stored top-down, so they go out in order.
+		header[26] = 1;
+		header[28] = 24;
+		putLittle32(header + 34, (uint32_t)dataSize);
+		writeBytes(header, sizeof(header));
+
+	}
+	else {
+
+		static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		unsigned char ihdr[13] = { 0 };
+		putBig32(ihdr, (uint32_t)width);
+		putBig32(ihdr + 4, (uint32_t)height);
+		ihdr[8] = 8;	// Bit depth.
+		ihdr[9] = 2;	// Truecolor RGB.
+		writeBytes(signature, sizeof(signature));
+		pngChunk("IHDR", ihdr, sizeof(ihdr));
+
+		/* zlib header: deflate, 32K window, no preset dictionary, fastest level. */
+
+		chunk.reserve(PNG_CHUNK_SIZE + 16);
+		chunk.push_back(0x78);
+		chunk.push_back(0x01);
+
+	}
+
+}
+
+ImageWriter::~ImageWriter() {
+
+	try {
+		finish();
+	}
+	catch (...) {
+	}
+
+}
+
+void ImageWriter::writeBytes(const void *bytes, size_t length) {
+
+	if (length > 0 && std::fwrite(bytes, 1, length, file) != length)
+		throw std::runtime_error("Could not write to " + path + ".");
+
+}
+
+void ImageWriter::pngChunk(const char *type, const unsigned char *data, size_t length) {
+
+	unsigned char header[8];
+	unsigned char trailer[4];
+
+	putBig32(header, (uint32_t)length);
+	memcpy(header + 4, type, 4);
+	putBig32(trailer, crc32(crc32(0, (const unsigned char *)type, 4), data, length));
+
+	writeBytes(header, 8);
+	writeBytes(data, length);
+	writeBytes(trailer, 4);
+
+}
+
+/*
+	Append uncompressed bytes to the zlib stream as stored deflate blocks.
+	A block header is five bytes: final flag, then length and its complement. Headers are patched in once each block is full.
+	Full chunks go out as IDAT immediately so only one chunk is ever buffered.
+*/
+
+void ImageWriter::pngData(const unsigned char *bytes, size_t length, bool last) {
+
+	adler = adler32(adler, bytes, length);
+
+	while (length > 0 || last) {
+
+		if (blockStart == NO_OPEN_BLOCK) {
+			blockStart = chunk.size();
+			chunk.resize(chunk.size() + 5);
+		}
+
+		size_t blockLength = chunk.size() - blockStart - 5;
+		size_t take = std::min(length, STORED_BLOCK_LIMIT - blockLength);
+		chunk.insert(chunk.end(), bytes, bytes + take);
+		bytes += take;
+		length -= take;
+		blockLength += take;
+
+		bool closeBlock = blockLength == STORED_BLOCK_LIMIT || (length == 0 && (last || chunk.size() >= PNG_CHUNK_SIZE));
+
+		if (!closeBlock)
+			break;
+
+		bool finalBlock = last && length == 0;
+		chunk[blockStart] = finalBlock ? 1 : 0;
+		chunk[blockStart + 1] = (unsigned char)blockLength;
+		chunk[blockStart + 2] = (unsigned char)(blockLength >> 8);
+		chunk[blockStart + 3] = (unsigned char)~blockLength;
+		chunk[blockStart + 4] = (unsigned char)(~blockLength >> 8);
+		blockStart = NO_OPEN_BLOCK;
+
+		if (finalBlock) {
+			unsigned char checksum[4];
+			putBig32(checksum, adler);
+			chunk.insert(chunk.end(), checksum, checksum + 4);
+		}
+
+		if (chunk.size() >= PNG_CHUNK_SIZE || finalBlock) {
+			pngChunk("IDAT", chunk.data(), chunk.size());
+			chunk.clear();
+		}
+
+		if (finalBlock)
+			break;
+
+	}
+
+}
+
+/*Send the finished row to disk. Both formats store rows top-down, so the file is written front to back and can be a pipe.*/
+
+void ImageWriter::emitRow() {
+
+	/* The row is consumed even if writing it fails, so a later write or finish never fills past its end. */
+
+	rowFill = 0;
+
+	if (rowsWritten >= height)
+		throw std::runtime_error("More colors than fit in the image.");
+
+	if (format == ImageFormat::Bmp) {
+		writeBytes(row.data(), row.size());
+	}
+	else {
+		pngData(row.data(), row.size(), rowsWritten == height - 1);
+	}
+
+	rowsWritten++;
+
+}
+
+void ImageWriter::write(const Color *colors, size_t count) {
+
+	unsigned char *pixels = row.data() + (format == ImageFormat::Png ? 1 : 0);
+
+	for (size_t i = 0; i < count; i++) {
+
+		Color color = colors[i];
+		unsigned char *pixel = pixels + rowFill * 3;
+
+		if (format == ImageFormat::Bmp) {
+			pixel[0] = (unsigned char)blueOf(color);
+			pixel[1] = (unsigned char)greenOf(color);
+			pixel[2] = (unsigned char)redOf(color);
+		}
+		else {
+			pixel[0] = (unsigned char)redOf(color);
+			pixel[1] = (unsigned char)greenOf(color);
+			pixel[2] = (unsigned char)blueOf(color);
+		}
+
+		if (++rowFill == (size_t)width)
+			emitRow();
+
+	}
+
+}
+
+/*Pad the rest of the image with white and close the file.*/
+
+void ImageWriter::finish() {
+
+	if (file == NULL)
+		return;
+
+	try {
+
+		const Color white = 0xFFFFFF;
+
+		while (rowsWritten < height)
+			write(&white, 1);
+
+		if (format == ImageFormat::Png)
+			pngChunk("IEND", NULL, 0);
+
+	}
+	catch (...) {
+		std::fclose(file);
+		file = NULL;
+		throw;
+	}
+
+	bool closed = std::fclose(file) == 0;
+	file = NULL;
+
+	if (!closed)
+		throw std::runtime_error("Could not write to " + path + ".");
+
+}
+
+/*
+	Write a preview of a color list. The format follows the file extension (.png for PNG, BMP otherwise).
+	width 0 picks the smallest square that holds every color.
+*/
+
+void writeImage(const ColorList &values, const std::string &path, int width) {
+
+	int count = std::max((int)values.size(), 1);
+
+	if (width <= 0)
+		width = squarePalette(count);
+
+	ImageWriter writer(path, imageFormatForPath(path), width, (count + width - 1) / width);
+	writer.write(values.data(), values.size());
+	writer.finish();
+
+}
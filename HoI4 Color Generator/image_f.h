@@ -0,0 +1,72 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ImageWriter streams a palette preview to a 24-bit top-down BMP or an RGB PNG, one row at a time, front to back (no seeking).
+Colors fill the image row-major from the top-left corner. Pixels left over after the last color are white.
+Only one row is held in memory (plus one compressed chunk for PNG), so image size is bounded by the disk, not by RAM.
+PNG data is written as stored (uncompressed) deflate blocks, which keeps the encoder free of dependencies.
+Throws std::runtime_error if the file cannot be written.
+*/
+
+enum class ImageFormat { Bmp, Png };
+
+ImageFormat imageFormatForPath(const std::string &path);
+
+class ImageWriter {
+
+public:
+
+	ImageWriter(const std::string &path, ImageFormat format, int width, int height);
+	~ImageWriter();
+
+	ImageWriter(const ImageWriter &) = delete;
+	ImageWriter &operator=(const ImageWriter &) = delete;
+
+	void write(const Color *colors, size_t count);
+	void finish();
+
+private:
+
+	void emitRow();
+	void writeBytes(const void *bytes, size_t length);
+	void pngChunk(const char *type, const unsigned char *data, size_t length);
+	void pngData(const unsigned char *bytes, size_t length, bool last);
+
+	std::string path;
+	FILE *file;
+	ImageFormat format;
+	int width;
+	int height;
+	int rowsWritten;
+	std::vector<unsigned char> row;			// Pixel bytes of the row being filled, in file order.
+	size_t rowFill;							// Pixels placed in row so far.
+	std::vector<unsigned char> chunk;		// PNG: stored deflate data waiting for the next IDAT.
+	size_t blockStart;						// PNG: where the open stored block begins in chunk, if one is open.
+	uint32_t adler;							// PNG: running Adler-32 of the uncompressed data.
+
+};
+
+void writeImage(const ColorList &values, const std::string &path, int width = 0);
@@ -0,0 +1,173 @@
+#include "luminance_f.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define CCF_X86_SIMD
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+	The weighted sum 299r + 587g + 114b is at most 255000, so the division by 1000 is done as (sum >> 3) / 125.
+	(sum >> 3) fits in 16 bits, and (y * 33555) >> 22 equals y / 125 for every y up to 31875.
+	Both vector kernels build the sum with madd: the 0x00RR00BB half of each color against (114, 299) plus green against (587, 0).
+*/
+
+static void scalarLuminance(const Color *colors, size_t count, unsigned char *luminance) {
+
+	for (size_t i = 0; i < count; i++)
+		luminance[i] = (unsigned char)getLuminance(colors[i]);
+
+}
+
+#ifdef CCF_X86_SIMD
+
+static inline __m128i luminance4(__m128i colors) {
+
+	const __m128i redBlueMask = _mm_set1_epi32(0x00FF00FF);
+	const __m128i channelMask = _mm_set1_epi32(0xFF);
+	const __m128i redBlueWeights = _mm_set1_epi32((299 << 16) | 114);
+	const __m128i greenWeights = _mm_set1_epi32(587);
+	const __m128i reciprocal = _mm_set1_epi16((short)33555);
+
+	__m128i sum = _mm_add_epi32(
+		_mm_madd_epi16(_mm_and_si128(colors, redBlueMask), redBlueWeights),
+		_mm_madd_epi16(_mm_and_si128(_mm_srli_epi32(colors, 8), channelMask), greenWeights));
+
+	return _mm_srli_epi32(_mm_mulhi_epu16(_mm_srli_epi32(sum, 3), reciprocal), 6);
+
+}
+
+static void sse2Luminance(const Color *colors, size_t count, unsigned char *luminance) {
+
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i l0 = luminance4(_mm_loadu_si128((const __m128i *)(colors + i)));
+		__m128i l1 = luminance4(_mm_loadu_si128((const __m128i *)(colors + i + 4)));
+		__m128i l2 = luminance4(_mm_loadu_si128((const __m128i *)(colors + i + 8)));
+		__m128i l3 = luminance4(_mm_loadu_si128((const __m128i *)(colors + i + 12)));
+		__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(l0, l1), _mm_packs_epi32(l2, l3));
+		_mm_storeu_si128((__m128i *)(luminance + i), bytes);
+	}
+
+	scalarLuminance(colors + i, count - i, luminance + i);
+
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+#define CCF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define CCF_TARGET_AVX2
+#endif
+
+CCF_TARGET_AVX2 static inline __m256i luminance8(__m256i colors) {
+
+	const __m256i redBlueMask = _mm256_set1_epi32(0x00FF00FF);
+	const __m256i channelMask = _mm256_set1_epi32(0xFF);
+	const __m256i redBlueWeights = _mm256_set1_epi32((299 << 16) | 114);
+	const __m256i greenWeights = _mm256_set1_epi32(587);
+	const __m256i reciprocal = _mm256_set1_epi16((short)33555);
+
+	__m256i sum = _mm256_add_epi32(
+		_mm256_madd_epi16(_mm256_and_si256(colors, redBlueMask), redBlueWeights),
+		_mm256_madd_epi16(_mm256_and_si256(_mm256_srli_epi32(colors, 8), channelMask), greenWeights));
+
+	return _mm256_srli_epi32(_mm256_mulhi_epu16(_mm256_srli_epi32(sum, 3), reciprocal), 6);
+
+}
+
+CCF_TARGET_AVX2 static void avx2Luminance(const Color *colors, size_t count, unsigned char *luminance) {
+
+	/* Packing works within 128-bit lanes, so the final permute restores color order. */
+
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m256i l0 = luminance8(_mm256_loadu_si256((const __m256i *)(colors + i)));
+		__m256i l1 = luminance8(_mm256_loadu_si256((const __m256i *)(colors + i + 8)));
+		__m256i l2 = luminance8(_mm256_loadu_si256((const __m256i *)(colors + i + 16)));
+		__m256i l3 = luminance8(_mm256_loadu_si256((const __m256i *)(colors + i + 24)));
+		__m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(l0, l1), _mm256_packs_epi32(l2, l3));
+		_mm256_storeu_si256((__m256i *)(luminance + i), _mm256_permutevar8x32_epi32(bytes, order));
+	}
+
+	sse2Luminance(colors + i, count - i, luminance + i);
+
+}
+
+static bool cpuHasAVX2() {
+
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+
+}
+
+#endif
+
+typedef void (*LuminanceKernel)(const Color *, size_t, unsigned char *);
+
+struct KernelChoice {
+	LuminanceKernel kernel;
+	const char *name;
+};
+
+static KernelChoice selectKernel() {
+
+#ifdef CCF_X86_SIMD
+	if (cpuHasAVX2())
+		return { avx2Luminance, "avx2" };
+	return { sse2Luminance, "sse2" };
+#else
+	return { scalarLuminance, "scalar" };
+#endif
+
+}
+
+/* Chosen on first use so that callers in other static initializers are safe. */
+
+static const KernelChoice &activeKernel() {
+	static const KernelChoice choice = selectKernel();
+	return choice;
+}
+
+void batchLuminance(const Color *colors, size_t count, unsigned char *luminance) {
+	activeKernel().kernel(colors, count, luminance);
+}
+
+const char *luminanceKernelName() {
+	return activeKernel().name;
+}
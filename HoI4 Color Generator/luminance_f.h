@@ -0,0 +1,34 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+batchLuminance writes the integer luminance (0-255) of each color in a contiguous block. Results match getLuminance exactly.
+The kernel is chosen once at runtime: AVX2 where the CPU supports it, SSE2 on other x86 builds, and a scalar loop everywhere else.
+luminanceKernelName reports which kernel is in use.
+*/
+
+void batchLuminance(const Color *colors, size_t count, unsigned char *luminance);
+
+const char *luminanceKernelName();
@@ -0,0 +1,131 @@
+#include "luminance_index_f.h"
+#include "luminance_f.h"
+#include "stats_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+	Two passes over the free rows of the box: the first counts each bucket, a prefix sum turns counts into offsets, and the second scatters.
+	Each pass gets a row's luminance from one batchLuminance call; only rows with free colors are computed.
+*/
+
+LuminanceIndex::LuminanceIndex(const ColorBitmap &reserved, const short *clampVals) {
+
+	StageTimer stage("index luminance");
+	Color row[256];
+	unsigned char rowLuminance[256];
+	uint64_t mask[4];
+	unsigned long next[256];
+
+	std::fill(offsets, offsets + 257, 0);
+
+	for (int pass = 0; pass < 2; pass++) {
+
+		for (int r = clampVals[0]; r <= clampVals[3]; r++) {
+			for (int g = clampVals[1]; g <= clampVals[4]; g++) {
+
+				freeRowMask(reserved, r, g, clampVals, mask);
+
+				if ((mask[0] | mask[1] | mask[2] | mask[3]) == 0)
+					continue;
+
+				for (int b = 0; b < 256; b++)
+					row[b] = packColor(r, g, b);
+				batchLuminance(row, 256, rowLuminance);
+
+				for (int w = 0; w < 4; w++) {
+					for (uint64_t bits = mask[w]; bits != 0; bits &= bits - 1) {
+						int b = 64 * w + lowestBit64(bits);
+						if (pass == 0)
+							offsets[rowLuminance[b] + 1]++;
+						else
+							colors[next[rowLuminance[b]]++] = row[b];
+					}
+				}
+
+			}
+		}
+
+		if (pass == 0) {
+			for (int key = 0; key < 256; key++)
+				offsets[key + 1] += offsets[key];
+			std::copy(offsets, offsets + 256, next);
+			colors.resize(offsets[256]);
+		}
+
+	}
+
+}
+
+unsigned long LuminanceIndex::count(int minLuminance, int maxLuminance) const {
+
+	if (minLuminance > maxLuminance)
+		return 0;
+
+	return offsets[maxLuminance + 1] - offsets[minLuminance];
+
+}
+
+unsigned long LuminanceIndex::count(int minLuminance, int maxLuminance, const ColorBitmap &exclude) const {
+
+	unsigned long total = 0;
+
+	if (minLuminance > maxLuminance)
+		return 0;
+
+	for (const Color *color = bucketBegin(minLuminance); color != bucketEnd(maxLuminance); color++)
+		total += !exclude.test(*color);
+
+	return total;
+
+}
+
+ColorList LuminanceIndex::take(int minLuminance, int maxLuminance, long n, short mContrast, const ColorBitmap *exclude) const {
+
+	ColorList values;
+
+	if (mContrast <= 1 && exclude == NULL) {
+		const Color *begin = bucketBegin(minLuminance);
+		values.assign(begin, begin + std::min((unsigned long)n, count(minLuminance, maxLuminance)));
+		return values;
+	}
+
+	for (int key = minLuminance; key <= maxLuminance && (long)values.size() < n; ) {
+
+		bool taken = false;
+
+		for (const Color *color = bucketBegin(key); color != bucketEnd(key) && (long)values.size() < n; color++) {
+			if (exclude != NULL && exclude->test(*color))
+				continue;
+			values.push_back(*color);
+			taken = true;
+			if (mContrast > 1)
+				break;
+		}
+
+		key += taken && mContrast > 1 ? mContrast : 1;
+
+	}
+
+	return values;
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+LuminanceIndex holds every free color of a clamp box in 256 buckets keyed by integer luminance (getLuminance / getContrast),
+with a prefix count per bucket. Colors within a bucket keep packed (red, green, blue) order, so the index is also the box's free colors sorted by brightness.
+Building it reads the reserved bitmap once (two passes over the box, 4 bytes per free color); after that:
+	count(min, max) is a subtraction of two prefix counts.
+	take(min, max, n) copies the first n colors of the band, darkest first, with no scanning or sorting.
+The index is a snapshot. Colors reserved after it was built can be skipped by passing the current bitmap as exclude, at the cost of one bit test per color;
+colors freed after it was built need a new index.
+*/
+
+class LuminanceIndex {
+
+public:
+
+	LuminanceIndex(const ColorBitmap &reserved, const short *clampVals);
+
+	unsigned long count(int minLuminance, int maxLuminance) const;
+	unsigned long count(int minLuminance, int maxLuminance, const ColorBitmap &exclude) const;
+
+	/*
+		Up to n colors of the band in brightness order. A contrast above 1 keeps consecutive colors that far apart in luminance,
+		which takes one color from every mContrast-th non-empty bucket.
+	*/
+	ColorList take(int minLuminance, int maxLuminance, long n, short mContrast = 1, const ColorBitmap *exclude = NULL) const;
+
+	const Color *bucketBegin(int luminance) const { return colors.data() + offsets[luminance]; }
+	const Color *bucketEnd(int luminance) const { return colors.data() + offsets[luminance + 1]; }
+	size_t size() const { return colors.size(); }
+
+private:
+
+	ColorList colors;
+	unsigned long offsets[257];			// Bucket b holds colors[offsets[b]] up to colors[offsets[b + 1]].
+
+};
@@ -1,6 +1,17 @@
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <filesystem>
 #include "generator_f.h"
+#include "cache_f.h"
+#include "sources_f.h"
+#include "province_map_f.h"
+#include "region_f.h"
+#include "audit_f.h"
+#include "adjacency_f.h"
+#include "server_f.h"
+#include "cli_f.h"
+#include "stats_f.h"
 
 /*
 	Author: Derek Warter
@@ -23,63 +34,407 @@
 	along with this program.  If not, see https://www.gnu.org/licenses/.
 */
 
-int main() {
+/*Print the --stats summary and write the --trace file, if either was asked for.*/
 
-	RGB values;												// Reserved values to acquire.
-	RGB unreservedValues;									// Values to generate.
-	long pCount;											// Number of provinces (colors) to generate.
-	short mContrast;										// Minimum contrast between luminance values.
-	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };		// Minimum and maximum RGB values.
-	short priorityVals[3] = { 1, 0, 0 };					// UNUSED.
-	std::string confirm;									// User input determining whether or not to sort. DEPRECATED.
-	long maxFind;											// Max values to look for based upon number of provinces found. Deprecated.
-	std::unordered_map<std::string, std::string> hashMap;	// Hash table containing keys for all reserved colors.
+static void reportStats(const CommandLine &options) {
+
+	if (options.stats)
+		printStats(std::cout);
+
+	if (options.tracePath.empty())
+		return;
+
+	try {
+		writeTrace(options.tracePath);
+	}
+	catch (const std::exception &e) {
+		std::cout << e.what() << std::endl;
+	}
+
+}
+
+/*Counts of each kind of problem --audit found.*/
+
+static void printAuditSummary(const std::string &csv, const DefinitionAudit &audit) {
+
+	std::cout << "Audited " << csv << ": " << audit.rows.size() << " rows on " << audit.lines << " lines." << std::endl;
+
+	if (audit.clean()) {
+		std::cout << "No problems found." << std::endl;
+		return;
+	}
+
+	std::cout << "  malformed lines:       " << audit.malformed.size() << std::endl;
+	std::cout << "  colors outside 0-255:  " << audit.badChannels.size() << std::endl;
+	std::cout << "  duplicate colors:      " << audit.duplicateColors.size() << std::endl;
+	std::cout << "  negative IDs:          " << audit.negativeIds.size() << std::endl;
+	std::cout << "  duplicate IDs:         " << audit.duplicateIds.size() << std::endl;
+	std::cout << "  missing IDs:           " << audit.missingIdCount() << " (in " << audit.missingIds.size() << " ranges)" << std::endl;
+
+}
+
+int main(int argc, char *argv[]) {
+
+	ColorList unreservedValues;								// Values to generate.
+	CommandLine options;									// Parsed command line. Holds the job settings in non-interactive runs.
+	std::string confirm;									// User input determining whether or not to sort.
+	ReservedSet reserved;									// Bitmap containing a bit for every reserved color, plus the province count and highest province ID.
+	std::vector<ReservedSource> sources;					// Each definition file's own reserved set, for the collision report.
+	std::unique_ptr<ColorBitmap> definedColors;				// The definitions' colors alone, before the province map's are merged in.
 
 	std::cout << "Clausewitz Color Factory" << std::endl << std::endl;
 
+	try {
+		options = parseCommandLine(argc, argv);
+	}
+	catch (const std::exception &e) {
+		std::cout << e.what() << std::endl << std::endl;
+		printUsage();
+		return 1;
+	}
+
+	if (options.help) {
+		printUsage();
+		return 0;
+	}
+
+	if (options.listRegions) {
+		printRegionPresets();
+		return 0;
+	}
+
+	/* Region bitmaps are cached beside the first input's reserved-set cache, a directory the user owns, never in the shared temp directory. */
+
+	if (options.useCache) {
+		std::error_code error;
+		std::filesystem::path directory(options.inputPaths[0]);
+		if (!std::filesystem::is_directory(directory, error))
+			directory = directory.parent_path();
+		setRegionCacheDirectory(directory.empty() ? "." : directory.string());
+	}
+
 	/*
-		Start by acquiring the list of reserved colors. If none is found, the software will simply generate every color in 24-bit space. Try/catch is simply a failsafe.
+		Audit of one definition.csv. With --repair the replacement colors come from the usual generator, avoiding every color in the file,
+		and the repaired copy is audited again so the exit status says whether anything is left to fix by hand.
+	*/
+
+	if (!options.auditPath.empty()) {
+
+		try {
+
+			DefinitionAudit audit = auditDefinition(options.auditPath, options.job.threads);
+
+			printAuditSummary(options.auditPath, audit);
+
+			if (!options.auditReportPath.empty())
+				writeAuditReport(options.auditReportPath, options.auditPath, audit);
+
+			if (!options.repairPath.empty()) {
+
+				ColorList freshColors;
+
+				if (audit.colorsToReplace() > 0) {
+					GenerationJob job = options.job;
+					job.pCount = audit.colorsToReplace();
+					freshColors = runGenerationJob(job, audit.colors);
+				}
+
+				repairDefinition(options.auditPath, audit, freshColors, options.repairPath);
+				audit = auditDefinition(options.repairPath, options.job.threads);
+
+				std::cout << std::endl << "Wrote " << options.repairPath << " with " << freshColors.size() << " new colors." << std::endl;
+				printAuditSummary(options.repairPath, audit);
+
+			}
+
+			reportStats(options);
+			return audit.clean() ? 0 : 1;
+
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+	}
+
+	/*
+		Client of an allocation server: the server owns the reserved colors, so nothing is read here.
+	*/
+
+	if (!options.connectPath.empty()) {
+
+		long firstProvinceId = 1;
+
+		try {
+			unreservedValues = requestColors(options.connectPath, options.job, firstProvinceId);
+			writeJobOutput(options.job, unreservedValues, firstProvinceId);
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+		std::cout << "Received " << unreservedValues.size() << " colors from " << options.connectPath << "." << std::endl;
+		reportStats(options);
+		return 0;
+
+	}
+
+	/*
+		Start by acquiring the list of reserved colors. A missing file or a malformed row stops the program with a description of the problem.
+		The reserved bitmap is built once and shared by every job. It is cached next to each input so unchanged definitions load without parsing.
+		Several inputs are loaded in parallel and merged into one bitmap.
 	*/
 
 	try {
-		values = getReservedList("definition.csv");
+		sources = loadReservedSources(expandDefinitionInputs(options.inputPaths), options.useCache, options.job.threads);
+		reserved = mergeReservedSources(sources);
 	}
-	catch (...) {
-		std::cout << "Could not open definition.csv. Please ensure the file is in the installation directory.";
+	catch (const std::exception &e) {
+		std::cout << e.what() << std::endl;
+		if (options.inputPaths.size() == 1)
+			std::cout << "Could not read " << options.inputPaths[0] << ". Please ensure the file is in the installation directory and correctly formatted.";
+		else
+			std::cout << "Could not read the definition files. Please ensure they exist and are correctly formatted.";
+		if (!options.interactive)
+			return 1;
 		std::cin.get();
 		return 0;
 	}
 
-	std::cout << "There are " << values.size() << " provinces in the definitions.csv file." << std::endl;
+	if (sources.size() == 1) {
+		std::cout << "There are " << reserved.provinceCount << " provinces in the " << sources[0].path << " file";
+		std::cout << (reserved.cacheStatus == "parsed" ? "." : " (" + reserved.cacheStatus + ").") << std::endl;
+	}
+	else {
+
+		for (size_t i = 0; i < sources.size(); i++)
+			std::cout << "  " << sources[i].path << ": " << sources[i].set.provinceCount << " provinces (" << sources[i].set.cacheStatus << ")" << std::endl;
+
+		std::cout << "There are " << reserved.provinceCount << " reserved colors in " << sources.size() << " definition files";
+		std::cout << ", " << countCollisions(sources) << " of them used by more than one file." << std::endl;
+
+	}
 
-	// maxFind = MAX_VALUES_TO_GENERATE - values.size(); DEPRECATED.
+	/* A single input has no collisions, but the report is still written (empty) so scripts can rely on it. */
+
+	if (!options.collisionsPath.empty()) {
+		try {
+			writeCollisionReport(options.collisionsPath, sources, findCollisions(sources));
+			std::cout << "Collisions written to " << options.collisionsPath << "." << std::endl;
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+		}
+	}
 
 	/*
-		Keep seeking user input until we get the right values.
+		Colors already painted in provinces.bmp are reserved too, even if definition.csv does not list them yet.
 	*/
 
-	while (true) {
+	if (!options.provinceMapPath.empty()) {
+
+		try {
+
+			ProvinceMapScan map = scanProvinceMap(options.provinceMapPath);
+			ColorList undefined = colorsMissingFrom(map.colors, reserved.bitmap);
+			ColorList unused = colorsMissingFrom(reserved.bitmap, map.colors);
+
+			std::cout << options.provinceMapPath << " (" << map.width << "x" << map.height << ") uses " << map.colorCount << " colors: ";
+			std::cout << undefined.size() << " not in the definitions, and " << unused.size() << " defined colors do not appear in it." << std::endl;
+
+			if (!options.mapReportPath.empty()) {
+				writeMapReport(options.mapReportPath, undefined, unused);
+				std::cout << "Map report written to " << options.mapReportPath << "." << std::endl;
+			}
+
+			if (!options.colorProvincesPath.empty())
+				definedColors.reset(new ColorBitmap(reserved.bitmap));
+
+			reserved.bitmap.merge(map.colors);
+
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			if (!options.interactive)
+				return 1;
+			std::cin.get();
+			return 0;
+		}
+
+	}
+
+	/*
+		Adjacency coloring: provinces painted in the map but missing from the definitions get new colors, chosen so bordering provinces
+		are far apart in CIELAB. The new colors avoid everything reserved, including the placeholder colors they replace.
+	*/
+
+	if (!options.colorProvincesPath.empty()) {
+
+		try {
+
+			const GenerationJob &job = options.job;
+			ProvinceGraph graph = buildProvinceGraph(options.provinceMapPath);
+			ColorBitmap pool = job.regions.empty() && job.excludedRegions.empty() ? reserved.bitmap : constrainReserved(reserved.bitmap, job.regions, job.excludedRegions);
+			ProvinceColoring coloring = colorProvinces(graph, *definedColors, pool, job.clampVals, job.seed, job.threads);
+			ColorList newColors;
+
+			for (uint32_t v : coloring.recolored)
+				newColors.push_back(coloring.colors[v]);
+
+			ColorWriter rows(job.textPath, OutputFormat::Definition, reserved.maxProvinceId + 1, job.definitionFields);
+			rows.write(newColors.data(), newColors.size());
+			rows.finish();
+
+			recolorProvinceMap(options.provinceMapPath, options.colorProvincesPath, [&](Color color) {
+				return coloring.colors[graph.indexOf(color)];
+			});
+
+			std::cout << graph.colors.size() << " provinces share " << graph.edgeCount() << " borders. Recolored " << coloring.recolored.size();
+			std::cout << " in " << coloring.classes << " classes; neighbouring delta E is at least " << std::fixed << std::setprecision(1) << coloring.minNeighbourDeltaE;
+			std::cout << ", " << coloring.meanNeighbourDeltaE << " on average." << std::endl;
+			std::cout << "Wrote " << options.colorProvincesPath << " and " << newColors.size() << " definition rows to " << job.textPath << "." << std::endl;
+
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+		reportStats(options);
+		return 0;
+
+	}
 
-		validateUserInput(pCount, mContrast, clampVals, confirm);
+	/*
+		Server mode: hand colors out over a socket until stopped. Allocations are journaled so a restart continues where it left off.
+	*/
 
-		/*
-			Build hashMap from the reserved values RGB vector.
-		*/
+	if (!options.servePath.empty()) {
 
-		hashMap = hashReservedList(values);
+		try {
+			Generator generator(reserved);
+			AllocationServer server(generator, options.journalPath);
+			std::cout << "Replayed " << server.replayedEntries() << " journal entries from " << options.journalPath << "." << std::endl;
+			std::cout << "Serving colors on " << options.servePath << ". Press Ctrl+C to stop." << std::endl;
+			setProgressOutput(NULL);
+			runServer(options.servePath, server);
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+		std::cout << "Server stopped." << std::endl;
+		return 0;
+
+	}
+
+	/*
+		Batch mode: run every job in the file against the same reserved bitmap. A failing job is reported and the rest still run.
+	*/
+
+	if (!options.batchPath.empty()) {
+
+		std::vector<GenerationJob> jobs;
+		int failures = 0;
+
+		try {
+			jobs = readBatchFile(options.batchPath, options.job);
+		}
+		catch (const std::exception &e) {
+			std::cout << e.what() << std::endl;
+			return 1;
+		}
+
+		for (size_t i = 0; i < jobs.size(); i++) {
+			std::cout << "\nJob " << i + 1 << " of " << jobs.size() << ": " << jobs[i].textPath << std::endl;
+			try {
+				if (isStreamingJob(jobs[i])) {
+					std::cout << "\nStreamed " << streamJobOutput(jobs[i], reserved.bitmap, reserved.maxProvinceId + 1) << " colors." << std::endl;
+					continue;
+				}
+				unreservedValues = runGenerationJob(jobs[i], reserved.bitmap);
+				writeJobOutput(jobs[i], unreservedValues, reserved.maxProvinceId + 1);
+				std::cout << "\nGenerated " << unreservedValues.size() << " colors." << std::endl;
+			}
+			catch (const std::exception &e) {
+				std::cout << std::endl << e.what() << std::endl;
+				failures++;
+			}
+		}
+
+		std::cout << std::endl << jobs.size() - failures << " of " << jobs.size() << " jobs succeeded." << std::endl;
+		reportStats(options);
+		return failures == 0 ? 0 : 1;
+
+	}
+
+	/*
+		Streaming run: too many colors to hold in a list, so they go from the generator to the files chunk by chunk.
+	*/
+
+	if (!options.interactive && isStreamingJob(options.job)) {
+
+		try {
+			unsigned long streamed = streamJobOutput(options.job, reserved.bitmap, reserved.maxProvinceId + 1);
+			std::cout << "\nStreamed " << streamed << " colors to " << options.job.textPath << " and " << options.job.bmpPath << "." << std::endl;
+		}
+		catch (const std::exception &e) {
+			std::cout << std::endl << e.what() << std::endl;
+			reportStats(options);
+			return 1;
+		}
+
+		reportStats(options);
+		return 0;
+
+	}
+
+	/*
+		Non-interactive single run: every setting came from the command line.
+	*/
+
+	if (!options.interactive) {
+
+		try {
+			unreservedValues = runGenerationJob(options.job, reserved.bitmap);
+			std::cout << "\nGenerated " << unreservedValues.size() << " colors. Writing to file..." << std::endl;
+			writeJobOutput(options.job, unreservedValues, reserved.maxProvinceId + 1);
+		}
+		catch (const std::exception &e) {
+			std::cout << std::endl << e.what() << std::endl;
+			reportStats(options);
+			return 1;
+		}
+
+		std::cout << "Done!" << std::endl;
+		reportStats(options);
+		return 0;
+
+	}
+
+	/*
+		Keep seeking user input until we get the right values.
+	*/
+
+	while (true) {
+
+		validateUserInput(options.job.pCount, options.job.mContrast, options.job.clampVals, confirm);
+		options.job.sort = confirm.compare("y") == 0;
 
 		try {
 
 			/*
 				Generate unused values. Sort them if the user desires. 
-				Catch exception thrown if MAX_VALUES_TO_ATTEMPT is reached by the timeout counter in generateUnreservedValues.
+				Catch exception thrown if the clamped range does not hold enough free colors, or if the constraints cannot be met.
 			*/
 
-			unreservedValues = generateUnreservedValues(hashMap, pCount, mContrast, clampVals);
-			if (confirm.compare("y") == 0)
-				selectionRGBSort(unreservedValues);
+			unreservedValues = runGenerationJob(options.job, reserved.bitmap);
 		}
-		catch (...) {
+		catch (const std::exception &e) {
+			std::cout << std::endl << e.what() << std::endl;
 			std::cout << "Could not generate the desired number of values.\nTry reducing minimum contrast or desired value count." << std::endl << std::endl;
 			continue;
 		}
@@ -90,13 +445,18 @@ int main() {
 
 	std::cout << "\nGenerated " << unreservedValues.size() << " colors. Writing to file..." << std::endl;
 
-	/*
-		Write values to text-based list and a BMP output image.
-	*/
+	try {
+		writeJobOutput(options.job, unreservedValues, reserved.maxProvinceId + 1);
+	}
+	catch (const std::exception &e) {
+		std::cout << std::endl << e.what() << std::endl;
+		std::cout << "Press any key to exit." << std::endl;
+		std::cin.get();
+		std::cin.get();
+		return 1;
+	}
 
-	RGBToText(unreservedValues);
-	int imgSize = squarePalette((int)pCount);
-	RGBToBMP(unreservedValues, imgSize);
+	reportStats(options);
 
 	std::cout << "Done! Press any key to exit." << std::endl;
 
@@ -105,4 +465,4 @@ int main() {
 
 	return 0;
 
-}
\ No newline at end of file
+}
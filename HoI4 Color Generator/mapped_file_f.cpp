@@ -0,0 +1,126 @@
+#include "mapped_file_f.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) : data(NULL), length(0), file(INVALID_HANDLE_VALUE), mapping(NULL) {
+
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Cannot open " + path + ".");
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		throw std::runtime_error("Cannot read the size of " + path + ".");
+	}
+
+	length = (size_t)fileSize.QuadPart;
+
+	/* CreateFileMapping refuses zero-length files, so leave the range empty. */
+
+	if (length == 0)
+		return;
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+	if (mapping != NULL)
+		data = (const char *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+	if (data == NULL) {
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Cannot map " + path + " into memory.");
+	}
+
+}
+
+MappedFile::~MappedFile() {
+
+	if (data != NULL)
+		UnmapViewOfFile(data);
+	if (mapping != NULL)
+		CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) : data(NULL), length(0), fd(-1) {
+
+	fd = open(path.c_str(), O_RDONLY);
+
+	if (fd < 0)
+		throw std::runtime_error("Cannot open " + path + ".");
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("Cannot read the size of " + path + ".");
+	}
+
+	length = (size_t)info.st_size;
+
+	/* mmap refuses zero-length mappings, so leave the range empty. */
+
+	if (length == 0)
+		return;
+
+	void *view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	if (view == MAP_FAILED) {
+		close(fd);
+		throw std::runtime_error("Cannot map " + path + " into memory.");
+	}
+
+	madvise(view, length, MADV_SEQUENTIAL);
+	data = (const char *)view;
+
+}
+
+MappedFile::~MappedFile() {
+
+	if (data != NULL)
+		munmap((void *)data, length);
+	if (fd >= 0)
+		close(fd);
+
+}
+
+#endif
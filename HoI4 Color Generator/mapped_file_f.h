@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <stdexcept>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+MappedFile maps a file read-only into memory for as long as the object lives.
+Throws std::runtime_error if the file cannot be opened or mapped. Empty files map to an empty range.
+*/
+
+class MappedFile {
+
+public:
+
+	explicit MappedFile(const std::string &path);
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const char *begin() const { return data; }
+	const char *end() const { return data + length; }
+	size_t size() const { return length; }
+
+private:
+
+	const char *data;
+	size_t length;
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#else
+	int fd;
+#endif
+
+};
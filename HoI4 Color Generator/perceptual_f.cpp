@@ -0,0 +1,196 @@
+#include "perceptual_f.h"
+#include "stats_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+	Lab bounds used by the grid. sRGB colors stay well inside them (L 0-100, a about -86 to 98, b about -108 to 95).
+	Cells are never narrower than MIN_CELL_SIZE so that very small separations do not blow up the grid.
+*/
+
+static const float LAB_L_MIN = 0.0f, LAB_L_MAX = 100.0f;
+static const float LAB_AB_MIN = -128.0f, LAB_AB_MAX = 128.0f;
+static const float MIN_CELL_SIZE = 2.0f;
+
+/*Linearize the sRGB transfer curve once per channel value.*/
+
+struct LinearChannelTable {
+
+	float values[256];
+
+	LinearChannelTable() {
+		for (int i = 0; i < 256; i++) {
+			double c = i / 255.0;
+			values[i] = (float)(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+		}
+	}
+
+};
+
+static inline double labCurve(double t) {
+	return t > 216.0 / 24389.0 ? std::cbrt(t) : (24389.0 / 27.0 * t + 16.0) / 116.0;
+}
+
+/*Convert a packed sRGB color to CIELAB through linear RGB and XYZ.*/
+
+LabColor toLab(Color color) {
+
+	static const LinearChannelTable table;
+	const float *linear = table.values;
+
+	double r = linear[redOf(color)];
+	double g = linear[greenOf(color)];
+	double b = linear[blueOf(color)];
+
+	double x = (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047;
+	double y = 0.2126729 * r + 0.7151522 * g + 0.0721750 * b;
+	double z = (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883;
+
+	double fx = labCurve(x);
+	double fy = labCurve(y);
+	double fz = labCurve(z);
+
+	LabColor lab;
+	lab.L = (float)(116.0 * fy - 16.0);
+	lab.a = (float)(500.0 * (fx - fy));
+	lab.b = (float)(200.0 * (fy - fz));
+
+	return lab;
+
+}
+
+double deltaE(const LabColor &first, const LabColor &second) {
+
+	double dL = first.L - second.L;
+	double da = first.a - second.a;
+	double db = first.b - second.b;
+
+	return std::sqrt(dL * dL + da * da + db * db);
+
+}
+
+LabGrid::LabGrid(double minDeltaE) : minDistanceSquared(minDeltaE * minDeltaE) {
+
+	cellSize = std::max((float)minDeltaE, MIN_CELL_SIZE);
+	lCells = (int)std::ceil((LAB_L_MAX - LAB_L_MIN) / cellSize) + 1;
+	aCells = (int)std::ceil((LAB_AB_MAX - LAB_AB_MIN) / cellSize) + 1;
+	bCells = aCells;
+	heads.assign((size_t)lCells * aCells * bCells, -1);
+
+}
+
+void LabGrid::cellOf(const LabColor &color, int &l, int &a, int &b) const {
+
+	l = std::min(std::max((int)((color.L - LAB_L_MIN) / cellSize), 0), lCells - 1);
+	a = std::min(std::max((int)((color.a - LAB_AB_MIN) / cellSize), 0), aCells - 1);
+	b = std::min(std::max((int)((color.b - LAB_AB_MIN) / cellSize), 0), bCells - 1);
+
+}
+
+/*Check the candidate against every accepted color in the surrounding 3x3x3 block of cells.*/
+
+bool LabGrid::isSeparated(const LabColor &color) const {
+
+	int l, a, b;
+	cellOf(color, l, a, b);
+
+	for (int cl = std::max(l - 1, 0); cl <= std::min(l + 1, lCells - 1); cl++) {
+		for (int ca = std::max(a - 1, 0); ca <= std::min(a + 1, aCells - 1); ca++) {
+			for (int cb = std::max(b - 1, 0); cb <= std::min(b + 1, bCells - 1); cb++) {
+				for (int i = heads[cellIndex(cl, ca, cb)]; i >= 0; i = next[i]) {
+					double dL = color.L - points[i].L;
+					double da = color.a - points[i].a;
+					double db = color.b - points[i].b;
+					if (dL * dL + da * da + db * db < minDistanceSquared)
+						return false;
+				}
+			}
+		}
+	}
+
+	return true;
+
+}
+
+void LabGrid::insert(const LabColor &color) {
+
+	int l, a, b;
+	cellOf(color, l, a, b);
+	int cell = cellIndex(l, a, b);
+
+	points.push_back(color);
+	next.push_back(heads[cell]);
+	heads[cell] = (int)points.size() - 1;
+
+}
+
+/*
+	Perceptual alternative to generateUnreservedValues.
+	Walks the clamped cube in red, green, blue order and accepts a free color only if it is at least minDeltaE away from every color accepted so far.
+	The guarantee holds between every pair of generated colors, not just neighbours in the output list.
+*/
+
+ColorList generatePerceptualValues(const ColorBitmap &reserved, long pCount, double minDeltaE, short *clampVals) {
+
+	ColorList newValues;
+	LabGrid grid(minDeltaE);
+	GenerationCounters counters;
+	ProgressMeter meter(clampVals[3] - clampVals[0] + 1);
+
+	progressOutput() << "Generating unreserved colors at least " << minDeltaE << " apart (CIELAB)..." << std::endl;
+
+	for (int r = clampVals[0]; r <= clampVals[3] && (long)newValues.size() < pCount; r++, meter.advance()) {
+		for (int g = clampVals[1]; g <= clampVals[4] && (long)newValues.size() < pCount; g++) {
+			for (int b = clampVals[2]; b <= clampVals[5] && (long)newValues.size() < pCount; b++) {
+
+				Color color = packColor(r, g, b);
+
+				counters.examined++;
+
+				if (reserved.test(color)) {
+					counters.rejectedReserved++;
+					continue;
+				}
+
+				LabColor lab = toLab(color);
+
+				if (!grid.isSeparated(lab)) {
+					counters.rejectedContrast++;
+					continue;
+				}
+
+				grid.insert(lab);
+				newValues.push_back(color);
+
+			}
+		}
+	}
+
+	counters.accepted = newValues.size();
+	recordCounters(counters);
+
+	if ((long)newValues.size() < pCount)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(newValues.size()) + " are at least " + std::to_string(minDeltaE) + " apart.");
+
+	return newValues;
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+LabColor is a color in CIELAB space (D65 white point), converted from sRGB.
+deltaE is the CIE76 color difference, the Euclidean distance between two Lab colors.
+*/
+
+struct LabColor {
+	float L;
+	float a;
+	float b;
+};
+
+LabColor toLab(Color color);
+
+double deltaE(const LabColor &first, const LabColor &second);
+
+/*
+LabGrid is a uniform grid over Lab space holding every accepted color.
+Cells are at least minDeltaE wide, so a candidate only has to be compared against the 27 cells around its own.
+*/
+
+class LabGrid {
+
+public:
+
+	explicit LabGrid(double minDeltaE);
+
+	bool isSeparated(const LabColor &color) const;
+	void insert(const LabColor &color);
+
+private:
+
+	int cellIndex(int l, int a, int b) const { return (l * aCells + a) * bCells + b; }
+	void cellOf(const LabColor &color, int &l, int &a, int &b) const;
+
+	double minDistanceSquared;
+	float cellSize;
+	int lCells;
+	int aCells;
+	int bCells;
+	std::vector<int> heads;			// First point in each cell, or -1.
+	std::vector<int> next;			// Next point in the same cell, or -1.
+	std::vector<LabColor> points;
+
+};
+
+ColorList generatePerceptualValues(const ColorBitmap &reserved, long pCount, double minDeltaE, short *clampVals);
@@ -0,0 +1,155 @@
+#include "permutation_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*SplitMix64 step, used to spread the seed over the round keys.*/
+
+static uint64_t splitMix64(uint64_t &state) {
+
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+
+}
+
+ColorPermutation::ColorPermutation(const short *clampVals, uint64_t seed) {
+
+	std::copy(clampVals, clampVals + 6, this->clampVals);
+
+	greens = clampVals[4] - clampVals[1] + 1;
+	blues = clampVals[5] - clampVals[2] + 1;
+	boxSize = (uint32_t)(clampVals[3] - clampVals[0] + 1) * greens * blues;
+
+	halfBits = 1;
+	while (((uint64_t)1 << (2 * halfBits)) < boxSize)
+		halfBits++;
+	halfMask = ((uint32_t)1 << halfBits) - 1;
+
+	uint64_t state = seed;
+	for (int round = 0; round < 4; round++)
+		keys[round] = (uint32_t)splitMix64(state);
+
+}
+
+/*One pass of the network over 2 * halfBits bits. Each round mixes the right half with a multiply-xorshift hash keyed per round.*/
+
+uint32_t ColorPermutation::feistel(uint32_t value) const {
+
+	uint32_t left = value >> halfBits;
+	uint32_t right = value & halfMask;
+
+	for (int round = 0; round < 4; round++) {
+		uint32_t mixed = (right ^ keys[round]) * 0x9e3779b1u;
+		mixed ^= mixed >> 15;
+		mixed *= 0x85ebca6bu;
+		mixed ^= mixed >> 13;
+		uint32_t next = left ^ (mixed & halfMask);
+		left = right;
+		right = next;
+	}
+
+	return (left << halfBits) | right;
+
+}
+
+Color ColorPermutation::at(uint32_t index) const {
+
+	uint32_t value = feistel(index);
+
+	while (value >= boxSize)
+		value = feistel(value);
+
+	uint32_t b = value % blues;
+	uint32_t g = (value / blues) % greens;
+	uint32_t r = value / blues / greens;
+
+	return packColor(clampVals[0] + r, clampVals[1] + g, clampVals[2] + b);
+
+}
+
+PermutedColorStream::PermutedColorStream(const ColorBitmap &reserved, const short *clampVals, uint64_t seed, short mContrast)
+	: reserved(reserved), permutation(clampVals, seed), mContrast(mContrast), position(0), lastLuminance(-1) {
+}
+
+/*Copy up to count further colors into out. Returns how many were written; fewer than count only when the box runs out.*/
+
+size_t PermutedColorStream::next(Color *out, size_t count) {
+
+	size_t taken = 0;
+
+	for (; taken < count && position < permutation.size(); position++) {
+
+		Color color = permutation.at(position);
+		counts.examined++;
+
+		if (reserved.test(color)) {
+			counts.rejectedReserved++;
+			continue;
+		}
+
+		if (mContrast > 1) {
+			int luminance = getLuminance(color);
+			if (lastLuminance >= 0 && std::abs(luminance - lastLuminance) < mContrast) {
+				counts.rejectedContrast++;
+				continue;
+			}
+			lastLuminance = luminance;
+		}
+
+		out[taken++] = color;
+
+	}
+
+	counts.accepted += taken;
+
+	return taken;
+
+}
+
+/*
+	Seeded generation: the free colors of the clamp box in ColorPermutation order, so the palette is scattered across the box
+	rather than walked one channel at a time. The same seed and reserved set always give the same palette.
+*/
+
+ColorList generateSeededValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals, uint64_t seed) {
+
+	unsigned long available = countFreeColors(reserved, clampVals);
+
+	if ((unsigned long)pCount > available)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(available) + " unreserved colors exist in the clamped range.");
+
+	progressOutput() << "Generating unreserved colors in seeded order..." << std::endl;
+
+	PermutedColorStream stream(reserved, clampVals, seed, mContrast);
+	ColorList values(pCount);
+
+	values.resize(stream.next(values.data(), values.size()));
+	recordCounters(stream.counters());
+
+	if ((long)values.size() < pCount)
+		throw std::runtime_error("Could not generate requested colors. Only " + std::to_string(values.size()) + " meet the constraints.");
+
+	return values;
+
+}
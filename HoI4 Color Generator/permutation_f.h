@@ -0,0 +1,84 @@
+#pragma once
+
+#include "generator_f.h"
+#include "stats_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ColorPermutation is a seeded bijection over the colors of a clamp box, for palettes that should not come out in packed order
+(packed order keeps red and green fixed for long runs, so neighbouring colors in the list are near-identical).
+The box's colors are numbered 0 to size() - 1 in packed order. at(i) sends i through a four-round Feistel network over the smallest
+even number of bits that covers the box, and walks the cycle (applies the network again) until the result falls inside the box.
+That domain is less than four times the box, so a lookup averages under four rounds of the network, and no set of seen colors is needed.
+The same clamp box and seed always give the same order.
+*/
+
+class ColorPermutation {
+
+public:
+
+	ColorPermutation(const short *clampVals, uint64_t seed);
+
+	uint32_t size() const { return boxSize; }
+	Color at(uint32_t index) const;
+
+private:
+
+	uint32_t feistel(uint32_t value) const;
+
+	short clampVals[6];
+	uint32_t greens;
+	uint32_t blues;
+	uint32_t boxSize;
+	int halfBits;
+	uint32_t halfMask;
+	uint32_t keys[4];
+
+};
+
+/*
+PermutedColorStream hands out the free colors of a clamp box in ColorPermutation order, with the same interface as ColorStream (stream_f.h).
+Reserved colors are skipped with one bit test each. A contrast above 1 is measured against the last color accepted.
+*/
+
+class PermutedColorStream {
+
+public:
+
+	PermutedColorStream(const ColorBitmap &reserved, const short *clampVals, uint64_t seed, short mContrast = 1);
+
+	size_t next(Color *out, size_t count);
+	GenerationCounters counters() const { return counts; }
+
+private:
+
+	const ColorBitmap &reserved;
+	ColorPermutation permutation;
+	short mContrast;
+	uint32_t position;
+	int lastLuminance;
+	GenerationCounters counts;
+
+};
+
+ColorList generateSeededValues(const ColorBitmap &reserved, long pCount, short mContrast, short *clampVals, uint64_t seed);
@@ -0,0 +1,397 @@
+#include "province_map_f.h"
+#include "stats_f.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const size_t SCAN_BUFFER_SIZE = 1 << 20;		// Bytes of pixel rows read per call.
+
+static uint32_t readLittle16(const unsigned char *bytes) {
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8);
+}
+
+static uint32_t readLittle32(const unsigned char *bytes) {
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+/*Seek with a 64-bit offset; long is 32 bits on Windows, and a BMP's offsets are unsigned 32-bit.*/
+
+static bool seekTo(FILE *file, uint64_t offset) {
+#ifdef _WIN32
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+/*
+	Mark the colors of one run of BGR(A) pixels. Bytes B, G, R read little-endian are exactly the packed 0xRRGGBB value,
+	so unpacking is one load per pixel, and the comparison with the previous pixel skips the bitmap for the rest of a run.
+*/
+
+template <int BYTES_PER_PIXEL>
+static void markPixels(const unsigned char *pixels, int width, ColorBitmap &colors) {
+
+	Color previous = 0xFFFFFFFF;
+
+	for (int x = 0; x < width; x++, pixels += BYTES_PER_PIXEL) {
+
+		Color color = (Color)pixels[0] | ((Color)pixels[1] << 8) | ((Color)pixels[2] << 16);
+
+		if (color != previous) {
+			colors.set(color);
+			previous = color;
+		}
+
+	}
+
+}
+
+/*Layout of an open provinces.bmp, read from its headers.*/
+
+struct MapLayout {
+	int width = 0;
+	int height = 0;						// Always positive; top-down files are read in file order like the rest.
+	uint32_t bitsPerPixel = 0;
+	uint32_t dataOffset = 0;
+	uint32_t paletteOffset = 0;
+	size_t paletteCount = 0;			// 8-bit maps only.
+	size_t stride = 0;					// Bytes per row, padded to four.
+	Color palette[256] = { 0 };
+};
+
+typedef std::unique_ptr<FILE, int (*)(FILE *)> MapFile;
+
+/*An 8-bit pixel indexing past the palette has no color, so the map is refused rather than read as black.*/
+
+static std::runtime_error paletteIndexError(const std::string &path, unsigned int index, size_t paletteCount) {
+	return std::runtime_error(path + " uses palette entry " + std::to_string(index) + " but its palette has only " + std::to_string(paletteCount) + " entries.");
+}
+
+static void checkPaletteIndices(const unsigned char *pixels, int width, size_t paletteCount, const std::string &path) {
+
+	if (paletteCount >= 256)
+		return;
+
+	for (int x = 0; x < width; x++) {
+		if (pixels[x] >= paletteCount)
+			throw paletteIndexError(path, pixels[x], paletteCount);
+	}
+
+}
+
+/*Open a BMP, check it is one we can read, and leave the file positioned at the first pixel row.*/
+
+static MapFile openProvinceMap(const std::string &path, MapLayout &layout) {
+
+	MapFile file(std::fopen(path.c_str(), "rb"), std::fclose);
+
+	if (!file)
+		throw std::runtime_error("Cannot open " + path + ".");
+
+	/* File header (14 bytes) and the start of the info header, which every BMP version shares. */
+
+	unsigned char header[54];
+
+	if (std::fread(header, 1, sizeof(header), file.get()) != sizeof(header) || header[0] != 'B' || header[1] != 'M')
+		throw std::runtime_error(path + " is not a BMP file.");
+
+	uint32_t dataOffset = readLittle32(header + 10);
+	uint32_t infoSize = readLittle32(header + 14);
+	int32_t width = (int32_t)readLittle32(header + 18);
+	int32_t height = (int32_t)readLittle32(header + 22);
+	uint32_t bitsPerPixel = readLittle16(header + 28);
+	uint32_t compression = readLittle32(header + 30);
+	uint32_t paletteSize = readLittle32(header + 46);
+
+	/* Compression 3 (bit fields) is accepted for 32-bit images, which always use the standard BGRA layout in practice. */
+
+	if (infoSize < 40 || width <= 0 || height == 0 || !(compression == 0 || (compression == 3 && bitsPerPixel == 32)))
+		throw std::runtime_error(path + " is not an uncompressed BMP.");
+
+	if (bitsPerPixel != 8 && bitsPerPixel != 24 && bitsPerPixel != 32)
+		throw std::runtime_error(path + " has " + std::to_string(bitsPerPixel) + " bits per pixel; only 8, 24 and 32 are supported.");
+
+	layout.width = width;
+	layout.height = std::abs(height);
+	layout.bitsPerPixel = bitsPerPixel;
+	layout.dataOffset = dataOffset;
+	layout.paletteOffset = 14 + infoSize;
+	layout.stride = (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+
+	/* 8-bit maps: read the palette. */
+
+	if (bitsPerPixel == 8) {
+
+		unsigned char entries[256 * 4];
+		layout.paletteCount = paletteSize == 0 || paletteSize > 256 ? 256 : paletteSize;
+
+		if (!seekTo(file.get(), layout.paletteOffset) || std::fread(entries, 4, layout.paletteCount, file.get()) != layout.paletteCount)
+			throw std::runtime_error(path + " has a truncated palette.");
+
+		for (size_t i = 0; i < layout.paletteCount; i++)
+			layout.palette[i] = (Color)entries[4 * i] | ((Color)entries[4 * i + 1] << 8) | ((Color)entries[4 * i + 2] << 16);
+
+	}
+
+	if (!seekTo(file.get(), dataOffset))
+		throw std::runtime_error(path + " is truncated.");
+
+	return file;
+
+}
+
+ProvinceMapScan scanProvinceMap(const std::string &path) {
+
+	MapLayout layout;
+	MapFile file = openProvinceMap(path, layout);
+	ProvinceMapScan scan;
+	int width = layout.width;
+	uint32_t bitsPerPixel = layout.bitsPerPixel;
+
+	scan.width = layout.width;
+	scan.height = layout.height;
+
+	/* 8-bit maps: note which palette entries are used, and mark their colors at the end. */
+
+	const Color *palette = layout.palette;
+	bool used[256] = { false };
+
+	/* Row order does not matter for a color set, so bottom-up and top-down images are read the same way. */
+
+	size_t stride = layout.stride;
+	size_t rowsPerRead = std::max<size_t>(1, SCAN_BUFFER_SIZE / stride);
+	std::vector<unsigned char> buffer(rowsPerRead * stride);
+	StageTimer stage("scan map");
+
+	for (int row = 0; row < scan.height; ) {
+
+		size_t rows = std::min<size_t>(rowsPerRead, (size_t)(scan.height - row));
+
+		if (std::fread(buffer.data(), stride, rows, file.get()) != rows)
+			throw std::runtime_error(path + " is truncated.");
+
+		for (size_t i = 0; i < rows; i++) {
+
+			const unsigned char *pixels = buffer.data() + i * stride;
+
+			if (bitsPerPixel == 24)
+				markPixels<3>(pixels, width, scan.colors);
+			else if (bitsPerPixel == 32)
+				markPixels<4>(pixels, width, scan.colors);
+			else
+				for (int x = 0; x < width; x++)
+					used[pixels[x]] = true;
+
+		}
+
+		row += (int)rows;
+
+	}
+
+	for (int i = 0; i < 256; i++) {
+		if (used[i] && (size_t)i >= layout.paletteCount)
+			throw paletteIndexError(path, i, layout.paletteCount);
+		if (used[i])
+			scan.colors.set(palette[i]);
+	}
+
+	scan.colorCount = scan.colors.count();
+
+	return scan;
+
+}
+
+ProvinceMapReader::ProvinceMapReader(const std::string &path) : path(path), file(NULL), rowsRead(0), buffered(0), bufferIndex(0) {
+
+	MapLayout layout;
+	file = openProvinceMap(path, layout).release();
+
+	columns = layout.width;
+	rows = layout.height;
+	bitsPerPixel = layout.bitsPerPixel;
+	stride = layout.stride;
+	paletteCount = layout.paletteCount;
+	std::copy(layout.palette, layout.palette + 256, palette);
+	buffer.resize(std::max<size_t>(1, SCAN_BUFFER_SIZE / stride) * stride);
+	row.resize(columns);
+
+}
+
+ProvinceMapReader::~ProvinceMapReader() {
+
+	if (file != NULL)
+		std::fclose(file);
+
+}
+
+const Color *ProvinceMapReader::nextRow() {
+
+	if (rowsRead == rows)
+		return NULL;
+
+	if (bufferIndex == buffered) {
+		buffered = std::min<size_t>(buffer.size() / stride, (size_t)(rows - rowsRead));
+		bufferIndex = 0;
+		if (std::fread(buffer.data(), stride, buffered, file) != buffered)
+			throw std::runtime_error(path + " is truncated.");
+	}
+
+	const unsigned char *pixels = buffer.data() + bufferIndex * stride;
+	int step = bitsPerPixel / 8;
+
+	if (bitsPerPixel == 8) {
+		checkPaletteIndices(pixels, columns, paletteCount, path);
+		for (int x = 0; x < columns; x++)
+			row[x] = palette[pixels[x]];
+	}
+	else {
+		for (int x = 0; x < columns; x++, pixels += step)
+			row[x] = (Color)pixels[0] | ((Color)pixels[1] << 8) | ((Color)pixels[2] << 16);
+	}
+
+	bufferIndex++;
+	rowsRead++;
+
+	return row.data();
+
+}
+
+/*Header and palette are copied as they are (palette entries recolored), then the pixel rows; a 24- or 32-bit pixel keeps its fourth byte.*/
+
+void recolorProvinceMap(const std::string &path, const std::string &outPath, const std::function<Color(Color)> &recolor) {
+
+	MapLayout layout;
+	MapFile source = openProvinceMap(path, layout);
+	std::vector<unsigned char> header(layout.dataOffset);
+
+	if (layout.paletteOffset + 4 * layout.paletteCount > header.size())
+		throw std::runtime_error(path + " has its palette after the pixel data.");
+
+	if (std::fseek(source.get(), 0, SEEK_SET) != 0 || std::fread(header.data(), 1, header.size(), source.get()) != header.size())
+		throw std::runtime_error(path + " is truncated.");
+
+	for (size_t i = 0; i < layout.paletteCount; i++) {
+		Color color = recolor(layout.palette[i]);
+		unsigned char *entry = header.data() + layout.paletteOffset + 4 * i;
+		entry[0] = (unsigned char)blueOf(color);
+		entry[1] = (unsigned char)greenOf(color);
+		entry[2] = (unsigned char)redOf(color);
+	}
+
+	MapFile out(std::fopen(outPath.c_str(), "wb"), std::fclose);
+
+	if (!out || std::fwrite(header.data(), 1, header.size(), out.get()) != header.size())
+		throw std::runtime_error("Could not write " + outPath + ".");
+
+	size_t rowsPerRead = std::max<size_t>(1, SCAN_BUFFER_SIZE / layout.stride);
+	std::vector<unsigned char> buffer(rowsPerRead * layout.stride);
+	int step = layout.bitsPerPixel / 8;
+	StageTimer stage("recolor map");
+
+	for (int row = 0; row < layout.height; ) {
+
+		size_t rows = std::min<size_t>(rowsPerRead, (size_t)(layout.height - row));
+
+		if (std::fread(buffer.data(), layout.stride, rows, source.get()) != rows)
+			throw std::runtime_error(path + " is truncated.");
+
+		if (layout.bitsPerPixel == 8) {
+			for (size_t i = 0; i < rows; i++)
+				checkPaletteIndices(buffer.data() + i * layout.stride, layout.width, layout.paletteCount, path);
+		}
+		else {
+			for (size_t i = 0; i < rows; i++) {
+				unsigned char *pixels = buffer.data() + i * layout.stride;
+				Color previous = 0xFFFFFFFF;
+				Color replacement = 0;
+				for (int x = 0; x < layout.width; x++, pixels += step) {
+					Color color = (Color)pixels[0] | ((Color)pixels[1] << 8) | ((Color)pixels[2] << 16);
+					if (color != previous) {
+						replacement = recolor(color);
+						previous = color;
+					}
+					pixels[0] = (unsigned char)blueOf(replacement);
+					pixels[1] = (unsigned char)greenOf(replacement);
+					pixels[2] = (unsigned char)redOf(replacement);
+				}
+			}
+		}
+
+		if (std::fwrite(buffer.data(), layout.stride, rows, out.get()) != rows)
+			throw std::runtime_error("Could not write " + outPath + ".");
+
+		row += (int)rows;
+
+	}
+
+	if (std::fclose(out.release()) != 0)
+		throw std::runtime_error("Could not write " + outPath + ".");
+
+}
+
+ColorList colorsMissingFrom(const ColorBitmap &colors, const ColorBitmap &other) {
+
+	ColorList missing;
+
+	for (size_t w = 0; w < colors.words.size(); w++) {
+		for (uint64_t bits = colors.words[w] & ~other.words[w]; bits != 0; bits &= bits - 1)
+			missing.push_back((Color)(w * 64 + lowestBit64(bits)));
+	}
+
+	return missing;
+
+}
+
+static void writeColorLines(std::ofstream &out, const ColorList &values) {
+
+	for (Color color : values) {
+		out << "(" << redOf(color) << ", " << greenOf(color) << ", " << blueOf(color) << ") "
+			<< std::hex << std::setw(6) << std::setfill('0') << color << std::dec << '\n';
+	}
+
+}
+
+void writeMapReport(const std::string &path, const ColorList &undefined, const ColorList &unused) {
+
+	std::ofstream out(path);
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+	out << "# " << undefined.size() << " colors in the province map but not in the definitions" << '\n';
+	writeColorLines(out, undefined);
+	out << "# " << unused.size() << " colors in the definitions but not in the province map" << '\n';
+	writeColorLines(out, unused);
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+}
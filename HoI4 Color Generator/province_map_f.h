@@ -0,0 +1,95 @@
+#pragma once
+
+#include "generator_f.h"
+#include <cstdio>
+#include <functional>
+
+#include <string>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+scanProvinceMap reads a provinces.bmp and returns every color that appears in it.
+Uncompressed 24- and 32-bit BMPs are read directly; 8-bit BMPs through their palette. Rows are streamed through a buffer of about 1 MiB,
+so memory use does not grow with the map. Provinces are large runs of one color, so a pixel only touches the bitmap when it differs from its left neighbour.
+Throws std::runtime_error if the file cannot be read or is not a supported BMP, or if an 8-bit pixel indexes past the palette.
+
+colorsMissingFrom lists the colors of `colors` that are not in `other`, in packed order.
+writeMapReport writes the colors found in the map but not in the definitions, then those defined but not in the map.
+*/
+
+struct ProvinceMapScan {
+	ColorBitmap colors;
+	unsigned long colorCount = 0;
+	int width = 0;
+	int height = 0;
+};
+
+ProvinceMapScan scanProvinceMap(const std::string &path);
+
+/*
+ProvinceMapReader decodes a provinces.bmp one row at a time into packed colors, in file order (the bottom row first in most BMPs).
+Consecutive rows are neighbours in either order, which is all adjacency needs. Rows are read through the same 1 MiB buffer as scanProvinceMap.
+nextRow returns the next row, width() colors long and valid until the following call, or NULL after the last row.
+
+recolorProvinceMap copies a provinces.bmp to outPath with every color replaced by recolor(color), keeping the file's format:
+24- and 32-bit pixels are rewritten row by row, and an 8-bit map only has its palette rewritten.
+*/
+
+class ProvinceMapReader {
+
+public:
+
+	explicit ProvinceMapReader(const std::string &path);
+	~ProvinceMapReader();
+
+	ProvinceMapReader(const ProvinceMapReader &) = delete;
+	ProvinceMapReader &operator=(const ProvinceMapReader &) = delete;
+
+	int width() const { return columns; }
+	int height() const { return rows; }
+
+	const Color *nextRow();
+
+private:
+
+	std::string path;
+	FILE *file;
+	int columns;
+	int rows;
+	int rowsRead;
+	uint32_t bitsPerPixel;
+	size_t stride;
+	size_t paletteCount;				// 8-bit maps only.
+	Color palette[256];
+	std::vector<unsigned char> buffer;
+	size_t buffered;					// Rows in buffer.
+	size_t bufferIndex;					// Next row of buffer to decode.
+	ColorList row;
+
+};
+
+void recolorProvinceMap(const std::string &path, const std::string &outPath, const std::function<Color(Color)> &recolor);
+
+ColorList colorsMissingFrom(const ColorBitmap &colors, const ColorBitmap &other);
+
+void writeMapReport(const std::string &path, const ColorList &undefined, const ColorList &unused);
@@ -0,0 +1,526 @@
+#include "region_f.h"
+#include "perceptual_f.h"
+#include "stats_f.h"
+#include <map>
+#include <memory>
+#include <functional>
+#include <filesystem>
+#include <future>
+#include <random>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+	Built-in presets. The ranges are starting points taken from the vanilla maps' own colors, not rules of the games;
+	anything more specific can be written as a spec.
+*/
+
+const std::vector<RegionPreset> &regionPresets() {
+
+	static const std::vector<RegionPreset> presets = {
+		{ "hoi4-sea", "hsv:190-250,40-100,20-80", "deep blues for sea provinces" },
+		{ "hoi4-lake", "hsv:170-200,30-100,40-90", "lighter cyan blues for lakes" },
+		{ "eu4-sea", "hsv:200-240,50-100,30-90", "saturated blues for sea provinces" },
+		{ "eu4-wasteland", "hsv:0-60,0-30,15-50", "dull browns and dark grays for wastelands" },
+		{ "vivid", "chroma:40-200", "strongly colored, far from gray" },
+		{ "near-gray", "chroma:0-10", "grays and colors close to gray" },
+		{ "dark", "lab:0-30,-128-128,-128-128", "CIELAB lightness below 30" },
+		{ "light", "lab:75-100,-128-128,-128-128", "CIELAB lightness above 75" },
+	};
+
+	return presets;
+
+}
+
+static const size_t MEMORY_TERMS = 16;		// Compiled terms kept in memory.
+
+static std::string regionCacheDirectory;
+
+void setRegionCacheDirectory(const std::string &directory) {
+	regionCacheDirectory = directory;
+}
+
+/*Parse "lo-hi". The low end may be negative, so the separator is the first - after the first number. Only hue ranges may wrap (lo above hi).*/
+
+static void parseRange(const std::string &term, const std::string &text, double minimum, double maximum, double range[2], bool wraps = false) {
+
+	char *end = NULL;
+	range[0] = std::strtod(text.c_str(), &end);
+	bool valid = end != text.c_str() && *end == '-';
+
+	if (valid) {
+		const char *high = end + 1;
+		range[1] = std::strtod(high, &end);
+		valid = end != high && *end == '\0';
+	}
+
+	if (!valid || range[0] < minimum || range[1] > maximum || (range[0] > range[1] && !wraps))
+		throw std::runtime_error("Region " + term + ": expected a range from " + std::to_string((int)minimum) + " to " + std::to_string((int)maximum) + " such as 10-20, got \"" + text + "\".");
+
+}
+
+/*Hue (0-360), saturation and value (0-100) of a color.*/
+
+static void toHsv(Color color, double &h, double &s, double &v) {
+
+	int r = redOf(color), g = greenOf(color), b = blueOf(color);
+	int high = std::max(r, std::max(g, b));
+	int low = std::min(r, std::min(g, b));
+	double spread = high - low;
+
+	v = high * 100.0 / 255.0;
+	s = high == 0 ? 0 : spread * 100.0 / high;
+
+	if (spread == 0)
+		h = 0;
+	else if (high == r)
+		h = 60.0 * std::fmod((g - b) / spread + 6.0, 6.0);
+	else if (high == g)
+		h = 60.0 * ((b - r) / spread + 2.0);
+	else
+		h = 60.0 * ((r - g) / spread + 4.0);
+
+}
+
+/*Evaluate inside for every color of the spectrum. Each worker fills whole red planes, so no two threads write the same word.*/
+
+static ColorBitmap compileTerm(const std::function<bool(Color)> &inside) {
+
+	ColorBitmap bitmap;
+	std::atomic<int> nextRed(0);
+
+	auto worker = [&]() {
+		for (int r; (r = nextRed++) < 256; ) {
+			for (int g = 0; g < 256; g++) {
+				size_t base = ((size_t)r << 10) | ((size_t)g << 2);
+				for (int w = 0; w < 4; w++) {
+					uint64_t word = 0;
+					for (int bit = 0; bit < 64; bit++) {
+						if (inside(packColor(r, g, 64 * w + bit)))
+							word |= (uint64_t)1 << bit;
+					}
+					bitmap.words[base + w] = word;
+				}
+			}
+		}
+	};
+
+	std::vector<std::thread> pool;
+
+	for (unsigned int i = 1; i < std::thread::hardware_concurrency(); i++)
+		pool.push_back(std::thread(worker));
+
+	worker();
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	return bitmap;
+
+}
+
+/*A primitive term split into its kind and ranges, checked against the kind's bounds.*/
+
+struct RegionTerm {
+	std::string kind;
+	double ranges[3][2];
+};
+
+static RegionTerm parseTerm(const std::string &term) {
+
+	RegionTerm parsed;
+	size_t colon = term.find(':');
+	std::vector<std::string> fields;
+
+	parsed.kind = term.substr(0, colon);
+
+	if (colon != std::string::npos) {
+		std::string rest = term.substr(colon + 1);
+		for (size_t start = 0, comma; start <= rest.size(); start = comma + 1) {
+			comma = rest.find(',', start);
+			if (comma == std::string::npos)
+				comma = rest.size();
+			fields.push_back(rest.substr(start, comma - start));
+		}
+	}
+
+	const std::string &kind = parsed.kind;
+	size_t expected = kind == "chroma" ? 1 : 3;
+
+	if (colon == std::string::npos || (kind != "rgb" && kind != "hsv" && kind != "lab" && kind != "chroma")) {
+		std::string names;
+		for (const RegionPreset &preset : regionPresets())
+			names += std::string(names.empty() ? "" : ", ") + preset.name;
+		throw std::runtime_error("Unknown region \"" + term + "\". Use rgb:, hsv:, lab:, chroma: or a preset (" + names + ").");
+	}
+
+	if (fields.size() != expected)
+		throw std::runtime_error("Region " + term + ": " + kind + " expects " + std::to_string(expected) + (expected == 1 ? " range." : " comma-separated ranges."));
+
+	if (kind == "rgb") {
+		for (int c = 0; c < 3; c++)
+			parseRange(term, fields[c], 0, 255, parsed.ranges[c]);
+	}
+	else if (kind == "hsv") {
+		parseRange(term, fields[0], 0, 360, parsed.ranges[0], true);
+		parseRange(term, fields[1], 0, 100, parsed.ranges[1]);
+		parseRange(term, fields[2], 0, 100, parsed.ranges[2]);
+	}
+	else if (kind == "lab") {
+		parseRange(term, fields[0], 0, 100, parsed.ranges[0]);
+		parseRange(term, fields[1], -128, 128, parsed.ranges[1]);
+		parseRange(term, fields[2], -128, 128, parsed.ranges[2]);
+	}
+	else {
+		parseRange(term, fields[0], 0, 200, parsed.ranges[0]);
+	}
+
+	return parsed;
+
+}
+
+/*Build the bitmap of one primitive term.*/
+
+static ColorBitmap compilePrimitive(const std::string &term) {
+
+	RegionTerm parsed = parseTerm(term);
+	const double (*ranges)[2] = parsed.ranges;
+
+	if (parsed.kind == "rgb") {
+		return compileTerm([&](Color color) {
+			return redOf(color) >= ranges[0][0] && redOf(color) <= ranges[0][1] && greenOf(color) >= ranges[1][0] && greenOf(color) <= ranges[1][1]
+				&& blueOf(color) >= ranges[2][0] && blueOf(color) <= ranges[2][1];
+		});
+	}
+
+	if (parsed.kind == "hsv") {
+		bool wraps = ranges[0][0] > ranges[0][1];
+		return compileTerm([&](Color color) {
+			double h, s, v;
+			toHsv(color, h, s, v);
+			bool hue = wraps ? h >= ranges[0][0] || h <= ranges[0][1] : h >= ranges[0][0] && h <= ranges[0][1];
+			return hue && s >= ranges[1][0] && s <= ranges[1][1] && v >= ranges[2][0] && v <= ranges[2][1];
+		});
+	}
+
+	if (parsed.kind == "lab") {
+		return compileTerm([&](Color color) {
+			LabColor lab = toLab(color);
+			return lab.L >= ranges[0][0] && lab.L <= ranges[0][1] && lab.a >= ranges[1][0] && lab.a <= ranges[1][1] && lab.b >= ranges[2][0] && lab.b <= ranges[2][1];
+		});
+	}
+
+	return compileTerm([&](Color color) {
+		LabColor lab = toLab(color);
+		double chroma = std::sqrt((double)lab.a * lab.a + (double)lab.b * lab.b);
+		return chroma >= ranges[0][0] && chroma <= ranges[0][1];
+	});
+
+}
+
+/*
+	Disk cache of one compiled term: a magic string, the term's length, an FNV-1a checksum of the term and bitmap, the term (so a file name
+	collision is caught), then the bitmap. A file whose checksum does not match is ignored. The file is written to a temporary name that must
+	not exist yet (so a planted file or symlink is never written through) and renamed into place; any failure just means the term is compiled
+	again next time.
+*/
+
+static const char REGION_MAGIC[8] = { 'C', 'C', 'F', 'R', 'G', 'N', '0', '2' };
+
+static uint64_t fnv1a(uint64_t hash, const char *bytes, size_t length) {
+
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+
+}
+
+static uint64_t regionChecksum(const std::string &term, const ColorBitmap &bitmap) {
+
+	uint64_t hash = fnv1a(14695981039346656037ull, term.data(), term.size());
+
+	return fnv1a(hash, (const char *)bitmap.words.data(), bitmap.words.size() * sizeof(uint64_t));
+
+}
+
+static std::string regionCachePath(const std::string &term) {
+
+	if (regionCacheDirectory.empty())
+		return std::string();
+
+	char name[40];
+	std::snprintf(name, sizeof(name), "ccf-region-%016llx.bits", (unsigned long long)std::hash<std::string>()(term));
+
+	return (std::filesystem::path(regionCacheDirectory) / name).string();
+
+}
+
+static bool readRegionCache(const std::string &path, const std::string &term, ColorBitmap &bitmap) {
+
+	std::ifstream file(path, std::ios::binary);
+	char magic[8];
+	uint64_t length = 0;
+	uint64_t checksum = 0;
+
+	if (!file.read(magic, sizeof(magic)) || memcmp(magic, REGION_MAGIC, sizeof(magic)) != 0 || !file.read((char *)&length, sizeof(length)) || length != term.size())
+		return false;
+
+	std::string stored(term.size(), '\0');
+
+	if (!file.read((char *)&checksum, sizeof(checksum)) || !file.read(&stored[0], stored.size()) || stored != term)
+		return false;
+
+	if (!file.read((char *)bitmap.words.data(), bitmap.words.size() * sizeof(uint64_t)) || file.peek() != EOF)
+		return false;
+
+	return regionChecksum(term, bitmap) == checksum;
+
+}
+
+/*Create a file for writing, failing if anything (a file or a symlink) already has the name. fopen's "x" mode is C11 and MSVC lacks it.*/
+
+static FILE *createNewFile(const std::string &path) {
+
+#ifdef _WIN32
+	int fd = -1;
+
+	if (_sopen_s(&fd, path.c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0)
+		return NULL;
+
+	FILE *file = _fdopen(fd, "wb");
+
+	if (file == NULL)
+		_close(fd);
+#else
+	int fd = open(path.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+
+	if (fd < 0)
+		return NULL;
+
+	FILE *file = fdopen(fd, "wb");
+
+	if (file == NULL)
+		close(fd);
+#endif
+
+	return file;
+
+}
+
+static void writeRegionCache(const std::string &path, const std::string &term, const ColorBitmap &bitmap) {
+
+	char suffix[24];
+	std::snprintf(suffix, sizeof(suffix), ".%08x.tmp", (unsigned int)std::random_device()());
+	std::string temporary = path + suffix;
+	FILE *file = createNewFile(temporary);
+
+	if (file == NULL)
+		return;
+
+	uint64_t length = term.size();
+	uint64_t checksum = regionChecksum(term, bitmap);
+	bool written = std::fwrite(REGION_MAGIC, sizeof(REGION_MAGIC), 1, file) == 1
+		&& std::fwrite(&length, sizeof(length), 1, file) == 1
+		&& std::fwrite(&checksum, sizeof(checksum), 1, file) == 1
+		&& std::fwrite(term.data(), 1, term.size(), file) == term.size()
+		&& std::fwrite(bitmap.words.data(), sizeof(uint64_t), bitmap.words.size(), file) == bitmap.words.size();
+
+	if (std::fclose(file) != 0 || !written) {
+		std::remove(temporary.c_str());
+		return;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+
+	if (error)
+		std::remove(temporary.c_str());
+
+}
+
+/*
+	A compiled primitive term, from memory, the disk cache or a fresh compile, in that order.
+	Memory holds the MEMORY_TERMS most recently used terms (2 MiB each), so a server fed ever new specs stays bounded.
+	The lock only guards the table: the first caller for a term compiles it unlocked, and later callers wait on its future, so a slow
+	lab: term does not hold up requests that need other terms.
+*/
+
+typedef std::shared_future<std::shared_ptr<const ColorBitmap>> TermFuture;
+
+struct CompiledTerm {
+	TermFuture bitmap;
+	uint64_t lastUse;
+};
+
+static std::shared_ptr<const ColorBitmap> compiledTerm(const std::string &term) {
+
+	static std::mutex lock;
+	static std::map<std::string, CompiledTerm> compiled;
+	static uint64_t uses = 0;
+
+	std::promise<std::shared_ptr<const ColorBitmap>> promise;
+	TermFuture pending;
+
+	{
+		std::lock_guard<std::mutex> guard(lock);
+
+		auto found = compiled.find(term);
+
+		if (found != compiled.end()) {
+			found->second.lastUse = ++uses;
+			pending = found->second.bitmap;
+		}
+		else {
+
+			/* An evicted term still being compiled is finished by its owner; callers already waiting hold their own future. */
+
+			if (compiled.size() >= MEMORY_TERMS) {
+				auto oldest = compiled.begin();
+				for (auto entry = compiled.begin(); entry != compiled.end(); ++entry) {
+					if (entry->second.lastUse < oldest->second.lastUse)
+						oldest = entry;
+				}
+				compiled.erase(oldest);
+			}
+
+			compiled[term] = { promise.get_future().share(), ++uses };
+
+		}
+	}
+
+	if (pending.valid())
+		return pending.get();
+
+	try {
+
+		bool needsLab = term.compare(0, 4, "lab:") == 0 || term.compare(0, 7, "chroma:") == 0;
+		std::string cachePath = needsLab ? regionCachePath(term) : std::string();
+		std::shared_ptr<ColorBitmap> bitmap = std::make_shared<ColorBitmap>();
+
+		if (cachePath.empty() || !readRegionCache(cachePath, term, *bitmap)) {
+			*bitmap = compilePrimitive(term);
+			if (!cachePath.empty())
+				writeRegionCache(cachePath, term, *bitmap);
+		}
+
+		promise.set_value(bitmap);
+		return bitmap;
+
+	}
+	catch (...) {
+
+		/* A term that does not compile never will, so callers waiting on it, and later ones, get the same error. */
+
+		promise.set_exception(std::current_exception());
+		throw;
+
+	}
+
+}
+
+/*Split a spec on & and replace preset names by their terms.*/
+
+static std::vector<std::string> expandRegion(const std::string &spec) {
+
+	std::vector<std::string> terms;
+
+	for (size_t start = 0, amp; start <= spec.size(); start = amp + 1) {
+
+		amp = spec.find('&', start);
+		if (amp == std::string::npos)
+			amp = spec.size();
+
+		std::string term = spec.substr(start, amp - start);
+		bool preset = false;
+
+		for (const RegionPreset &candidate : regionPresets()) {
+			if (term == candidate.name) {
+				std::vector<std::string> expanded = expandRegion(candidate.spec);
+				terms.insert(terms.end(), expanded.begin(), expanded.end());
+				preset = true;
+			}
+		}
+
+		if (!preset)
+			terms.push_back(term);
+
+	}
+
+	return terms;
+
+}
+
+void validateRegion(const std::string &spec) {
+
+	for (const std::string &term : expandRegion(spec))
+		parseTerm(term);
+
+}
+
+ColorBitmap compileRegion(const std::string &spec) {
+
+	std::vector<std::string> terms = expandRegion(spec);
+	ColorBitmap region = *compiledTerm(terms[0]);
+
+	for (size_t i = 1; i < terms.size(); i++)
+		region.intersect(*compiledTerm(terms[i]));
+
+	return region;
+
+}
+
+/*Reserved plus every color outside all of regions or inside any of excludedRegions.*/
+
+ColorBitmap constrainReserved(const ColorBitmap &reserved, const std::vector<std::string> &regions, const std::vector<std::string> &excludedRegions) {
+
+	StageTimer stage("regions");
+	ColorBitmap allowed;
+
+	allowed.invert();
+
+	for (const std::string &spec : regions) {
+		for (const std::string &term : expandRegion(spec))
+			allowed.intersect(*compiledTerm(term));
+	}
+
+	for (const std::string &spec : excludedRegions)
+		allowed.subtract(compileRegion(spec));
+
+	allowed.invert();
+	allowed.merge(reserved);
+
+	return allowed;
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+A region is a set of colors described by a spec string: one or more terms joined by &, all of which a color must satisfy.
+	rgb:R1-R2,G1-G2,B1-B2		channel ranges, 0-255
+	hsv:H1-H2,S1-S2,V1-V2		hue in degrees (a range such as 330-30 wraps through red), saturation and value in percent
+	lab:L1-L2,A1-A2,B1-B2		CIELAB ranges, as toLab in perceptual_f.h
+	chroma:C1-C2				CIELAB chroma, the distance from the gray axis
+A term can also be the name of a preset from regionPresets, such as hoi4-sea or near-gray.
+
+validateRegion throws std::runtime_error describing the first bad term of a spec, without compiling anything.
+compileRegion evaluates a spec over the whole 24-bit spectrum once, in parallel, and returns the colors inside it as a ColorBitmap.
+Any number of threads may compile at once: each term is compiled by the first caller that needs it, while other terms compile alongside.
+The most recently used compiled terms (up to 16) are kept in memory. Terms that need CIELAB take about a second to compile, so they are also
+cached on disk in the directory given to setRegionCacheDirectory (none by default, and "" turns the disk cache off again). Use a directory
+only the user can write to: the command line uses the one holding the first input's reserved-set cache.
+
+constrainReserved folds regions into a reserved bitmap: every color outside the regions, or inside an excluded region, is marked reserved.
+The generators then honor the regions with no per-color test of their own.
+*/
+
+struct RegionPreset {
+	const char *name;
+	const char *spec;
+	const char *description;
+};
+
+const std::vector<RegionPreset> &regionPresets();
+
+void setRegionCacheDirectory(const std::string &directory);
+
+void validateRegion(const std::string &spec);
+
+ColorBitmap compileRegion(const std::string &spec);
+
+ColorBitmap constrainReserved(const ColorBitmap &reserved, const std::vector<std::string> &regions, const std::vector<std::string> &excludedRegions);
@@ -0,0 +1,532 @@
+#include "server_f.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const size_t MAX_REQUEST_LENGTH = 1 << 20;		// Longest request line accepted, enough for a large reserve list.
+static const size_t MAX_PENDING_OUTPUT = 16 << 20;		// Unsent reply bytes after which a client's requests wait until it reads.
+
+static std::string hexColor(Color color) {
+
+	char text[8];
+	std::snprintf(text, sizeof(text), "%06x", (unsigned int)color);
+
+	return text;
+
+}
+
+/*Read hex colors after a command word. Throws on anything that is not a 24-bit hex value.*/
+
+static ColorList readHexColors(std::istringstream &words) {
+
+	ColorList values;
+
+	for (std::string word; words >> word; ) {
+		char *end = NULL;
+		unsigned long value = std::strtoul(word.c_str(), &end, 16);
+		if (word.empty() || *end != '\0' || value >= (unsigned long)COLOR_SPACE_SIZE)
+			throw std::runtime_error("\"" + word + "\" is not a hex color.");
+		values.push_back((Color)value);
+	}
+
+	return values;
+
+}
+
+AllocationServer::AllocationServer(Generator &generator, const std::string &journalPath)
+	: generator(generator), journalPath(journalPath), journal(NULL), nextProvinceId(generator.maxProvinceId() + 1), replayed(0) {
+
+	replayJournal();
+
+	journal = std::fopen(journalPath.c_str(), "ab");
+
+	if (journal == NULL)
+		throw std::runtime_error("Cannot write journal " + journalPath + ".");
+
+}
+
+AllocationServer::~AllocationServer() {
+
+	if (journal != NULL)
+		std::fclose(journal);
+
+}
+
+/*
+	Journal lines: "+ <first ID> <hex>..." for generated colors, "r <hex>..." for reserved ones and "- <hex>..." for released ones.
+	A torn last line (the server died mid-write) is ignored, since its reply was never sent.
+*/
+
+void AllocationServer::replayJournal() {
+
+	std::ifstream in(journalPath);
+
+	for (std::string line; std::getline(in, line); ) {
+
+		std::istringstream words(line);
+		std::string kind;
+		long firstId = 0;
+
+		words >> kind;
+
+		try {
+			if (kind == "+" && words >> firstId) {
+				ColorList values = readHexColors(words);
+				claim(values, true);
+				nextProvinceId = std::max(nextProvinceId, firstId + (long)values.size());
+			}
+			else if (kind == "r") {
+				ColorList values = readHexColors(words);
+				claim(values, true);
+			}
+			else if (kind == "-") {
+				ColorList values = readHexColors(words);
+				for (Color color : values)
+					issued.reset(color);
+				generator.release(ColorSpan(values));
+			}
+			else {
+				continue;
+			}
+		}
+		catch (const std::exception &) {
+			continue;
+		}
+
+		replayed++;
+
+	}
+
+}
+
+void AllocationServer::appendJournal(const std::string &entry) {
+
+	if (std::fputs(entry.c_str(), journal) < 0 || std::fputc('\n', journal) == EOF || std::fflush(journal) != 0)
+		throw std::runtime_error("Could not write journal " + journalPath + ".");
+
+}
+
+/*Reserve values and record them as issued by this server; with onlyFree, colors that were already reserved stay someone else's.*/
+
+void AllocationServer::claim(const ColorList &values, bool onlyFree) {
+
+	for (Color color : values) {
+		if (!onlyFree || !generator.isReserved(color))
+			issued.set(color);
+	}
+
+	generator.reserve(ColorSpan(values));
+
+}
+
+std::string AllocationServer::handleRequest(const std::string &line) {
+
+	std::istringstream words(line);
+	std::string command;
+
+	words >> command;
+
+	try {
+
+		if (command == "status")
+			return "OK " + std::to_string(generator.available()) + " " + std::to_string(nextProvinceId);
+
+		if (command == "reserve" || command == "release") {
+
+			ColorList values = readHexColors(words);
+			std::string entry = command == "reserve" ? "r" : "-";
+			unsigned long fresh = 0;
+
+			for (Color color : values) {
+				if (command == "release" && !issued.test(color))
+					throw std::runtime_error(hexColor(color) + " was not handed out by this server and cannot be released.");
+				fresh += !generator.isReserved(color);
+				entry += " " + hexColor(color);
+			}
+
+			appendJournal(entry);
+
+			if (command == "reserve") {
+				claim(values, true);
+				return "OK " + std::to_string(fresh);
+			}
+
+			for (Color color : values)
+				issued.reset(color);
+
+			generator.release(ColorSpan(values));
+			return "OK";
+
+		}
+
+		GenerationJob job = parseJobLine(line, GenerationJob());
+
+		if (isStreamingJob(job))
+			throw std::runtime_error("Requests are limited to " + std::to_string(MAX_VALUES_TO_GENERATE) + " colors.");
+		GenerateOptions options;
+
+		options.mContrast = job.mContrast;
+		std::copy(job.clampVals, job.clampVals + 6, options.clampVals);
+		options.threads = std::max(job.threads, 1u);
+		options.minDeltaE = job.minDeltaE;
+		options.seeded = job.seeded;
+		options.seed = job.seed;
+		options.regions = job.regions;
+		options.excludedRegions = job.excludedRegions;
+		options.minLuminance = job.minLuminance;
+		options.maxLuminance = job.maxLuminance;
+		options.sort = job.sort;
+
+		ColorList values = generator.generate((size_t)job.pCount, options);
+		std::string colors;
+
+		for (Color color : values)
+			colors += " " + hexColor(color);
+
+		/* Journal first: if the write fails, the colors go back and the client gets an error instead. */
+
+		try {
+			appendJournal("+ " + std::to_string(nextProvinceId) + colors);
+		}
+		catch (...) {
+			generator.release(ColorSpan(values));
+			throw;
+		}
+
+		for (Color color : values)
+			issued.set(color);
+
+		std::string reply = "OK " + std::to_string(nextProvinceId) + colors;
+		nextProvinceId += (long)values.size();
+
+		return reply;
+
+	}
+	catch (const std::exception &e) {
+		return std::string("ERR ") + e.what();
+	}
+
+}
+
+#ifdef _WIN32
+
+void runServer(const std::string &, AllocationServer &) {
+	throw std::runtime_error("--serve needs Unix domain sockets and is not available on Windows.");
+}
+
+ColorList requestColors(const std::string &, const GenerationJob &, long &) {
+	throw std::runtime_error("--connect needs Unix domain sockets and is not available on Windows.");
+}
+
+#else
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static volatile std::sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+	stopRequested = 1;
+}
+
+static sockaddr_un socketAddress(const std::string &path) {
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+
+	if (path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("Socket path " + path + " is too long.");
+
+	std::copy(path.begin(), path.end(), address.sun_path);
+
+	return address;
+
+}
+
+static int connectSocket(const std::string &path) {
+
+	sockaddr_un address = socketAddress(path);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0)
+		return -1;
+
+	if (connect(fd, (const sockaddr *)&address, sizeof(address)) != 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+
+}
+
+static bool sendAll(int fd, const std::string &text) {
+
+	for (size_t sent = 0; sent < text.size(); ) {
+		ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return false;
+		sent += (size_t)n;
+	}
+
+	return true;
+
+}
+
+static bool setNonBlocking(int fd) {
+
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+
+}
+
+/*One connection: bytes of an unfinished request, replies not yet sent, and whether the client has stopped sending.*/
+
+struct ServerClient {
+	int fd;
+	std::string input;
+	std::string output;
+	bool closing;
+};
+
+/*Send as much pending output as the socket takes now. False if the connection is broken.*/
+
+static bool flushClient(ServerClient &client) {
+
+	size_t sent = 0;
+
+	while (sent < client.output.size()) {
+		ssize_t n = send(client.fd, client.output.data() + sent, client.output.size() - sent, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n <= 0)
+			return false;
+		sent += (size_t)n;
+	}
+
+	client.output.erase(0, sent);
+
+	return true;
+
+}
+
+/*Read what the client has sent and answer every complete line. False if the connection is broken.*/
+
+static bool readClient(ServerClient &client, AllocationServer &server) {
+
+	char buffer[65536];
+
+	while (!client.closing && client.output.size() < MAX_PENDING_OUTPUT) {
+
+		ssize_t n = recv(client.fd, buffer, sizeof(buffer), 0);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0)
+			return false;
+
+		if (n == 0) {
+			client.closing = true;
+			break;
+		}
+
+		client.input.append(buffer, (size_t)n);
+
+		size_t start = 0;
+
+		for (size_t end; (end = client.input.find('\n', start)) != std::string::npos; start = end + 1) {
+			std::string line = client.input.substr(start, end - start);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			client.output += server.handleRequest(line) + "\n";
+		}
+
+		client.input.erase(0, start);
+
+		if (client.input.size() > MAX_REQUEST_LENGTH) {
+			client.output += "ERR Request too long.\n";
+			client.closing = true;
+		}
+
+	}
+
+	return true;
+
+}
+
+/*
+	Single-threaded poll loop over non-blocking sockets. Each client's bytes are buffered until a newline, then every complete line is answered
+	in order. Replies queue in the client's output buffer and go out as its socket accepts them (POLLOUT), so a client that stops reading only
+	stalls itself: once MAX_PENDING_OUTPUT bytes are waiting, its further requests are left unread until it catches up.
+	A request is tiny next to the time it takes to serve, so handling one at a time costs nothing and makes each reservation atomic for free.
+*/
+
+void runServer(const std::string &socketPath, AllocationServer &server) {
+
+	int existing = connectSocket(socketPath);
+
+	if (existing >= 0) {
+		close(existing);
+		throw std::runtime_error("A server is already listening on " + socketPath + ".");
+	}
+
+	unlink(socketPath.c_str());
+
+	sockaddr_un address = socketAddress(socketPath);
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0 || !setNonBlocking(listener) || bind(listener, (const sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 64) != 0) {
+		if (listener >= 0)
+			close(listener);
+		throw std::runtime_error("Cannot listen on " + socketPath + ".");
+	}
+
+	struct sigaction stop = {};
+	stop.sa_handler = requestStop;
+	stopRequested = 0;
+	sigaction(SIGINT, &stop, NULL);
+	sigaction(SIGTERM, &stop, NULL);
+	std::signal(SIGPIPE, SIG_IGN);
+
+	std::vector<ServerClient> clients;
+	std::vector<pollfd> fds;
+
+	while (!stopRequested) {
+
+		fds.assign(1, pollfd{ listener, POLLIN, 0 });
+
+		for (const ServerClient &client : clients) {
+			short events = 0;
+			if (!client.closing && client.output.size() < MAX_PENDING_OUTPUT)
+				events |= POLLIN;
+			if (!client.output.empty())
+				events |= POLLOUT;
+			fds.push_back(pollfd{ client.fd, events, 0 });
+		}
+
+		if (poll(fds.data(), (nfds_t)fds.size(), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		for (size_t i = clients.size(); i-- > 0; ) {
+
+			ServerClient &client = clients[i];
+			short revents = fds[i + 1].revents;
+			bool open = (revents & (POLLERR | POLLNVAL)) == 0;
+
+			if (open && (revents & (POLLIN | POLLHUP)))
+				open = readClient(client, server);
+
+			if (open && !client.output.empty())
+				open = flushClient(client);
+
+			if (!open || (client.closing && client.output.empty())) {
+				close(client.fd);
+				clients.erase(clients.begin() + i);
+			}
+
+		}
+
+		if (fds[0].revents & POLLIN) {
+			for (int fd; (fd = accept(listener, NULL, NULL)) >= 0; ) {
+				if (setNonBlocking(fd))
+					clients.push_back(ServerClient{ fd, std::string(), std::string(), false });
+				else
+					close(fd);
+			}
+		}
+
+	}
+
+	for (const ServerClient &client : clients)
+		close(client.fd);
+
+	close(listener);
+	unlink(socketPath.c_str());
+
+}
+
+ColorList requestColors(const std::string &socketPath, const GenerationJob &job, long &firstProvinceId) {
+
+	int fd = connectSocket(socketPath);
+
+	if (fd < 0)
+		throw std::runtime_error("No server is listening on " + socketPath + ".");
+
+	std::string reply;
+	char buffer[65536];
+
+	if (!sendAll(fd, formatJobFlags(job) + "\n")) {
+		close(fd);
+		throw std::runtime_error("Lost the connection to " + socketPath + ".");
+	}
+
+	while (reply.empty() || reply.back() != '\n') {
+		ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			close(fd);
+			throw std::runtime_error("Lost the connection to " + socketPath + ".");
+		}
+		reply.append(buffer, (size_t)n);
+	}
+
+	close(fd);
+	reply.pop_back();
+
+	std::istringstream words(reply);
+	std::string status;
+
+	words >> status;
+
+	if (status != "OK" || !(words >> firstProvinceId))
+		throw std::runtime_error(reply.compare(0, 4, "ERR ") == 0 ? reply.substr(4) : "Unexpected reply from the server: " + reply);
+
+	return readHexColors(words);
+
+}
+
+#endif
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "color_factory.h"
+#include "cli_f.h"
+
+#include <string>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Allocation server: one long-running process owns the reserved colors, so separate scripts and users on one machine never receive the same color.
+
+runServer listens on a Unix domain socket and answers one request per line, in the order they arrive, with one reply line:
+	<job flags>            e.g. "--count 10 --clamp 0 0 100 60 60 255 --contrast 5"; the same flags as a batch line.
+	                       Reply: "OK <first province ID> <hex> <hex> ...". The colors are reserved and the IDs used up before the reply is sent.
+	reserve <hex> ...      Mark colors as taken, for provinces made by other tools. Reply: "OK <number newly reserved>".
+	release <hex> ...      Return colors this server handed out or reserved. Reply: "OK". Any other color (one from the definitions or the
+	                       province map, or never taken) fails the whole request, so a release can never free a color someone else owns.
+	status                 Reply: "OK <free colors> <next province ID>".
+Anything that fails gets "ERR <message>". Requests are handled one at a time on a single thread, so every reply reflects all earlier ones.
+
+Every change is appended to the journal and flushed before the reply, and the journal is replayed on start, so allocations survive a restart.
+A socket file left by a server that is no longer running is replaced; a live one is an error. SIGINT or SIGTERM stops the server cleanly.
+requestColors is the client side of a job request. Both throw std::runtime_error; on Windows they always do, since the server needs Unix sockets.
+*/
+
+class AllocationServer {
+
+public:
+
+	AllocationServer(Generator &generator, const std::string &journalPath);
+	~AllocationServer();
+
+	AllocationServer(const AllocationServer &) = delete;
+	AllocationServer &operator=(const AllocationServer &) = delete;
+
+	std::string handleRequest(const std::string &line);
+	unsigned long replayedEntries() const { return replayed; }
+
+private:
+
+	void replayJournal();
+	void appendJournal(const std::string &entry);
+	void claim(const ColorList &values, bool onlyFree);
+
+	Generator &generator;
+	ColorBitmap issued;					// Colors this server generated or newly reserved, the only ones release accepts.
+	std::string journalPath;
+	FILE *journal;
+	long nextProvinceId;
+	unsigned long replayed;
+
+};
+
+void runServer(const std::string &socketPath, AllocationServer &server);
+
+ColorList requestColors(const std::string &socketPath, const GenerationJob &job, long &firstProvinceId);
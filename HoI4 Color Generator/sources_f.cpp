@@ -0,0 +1,234 @@
+#include "sources_f.h"
+#include "stats_f.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static bool isDefinitionFile(const std::filesystem::path &path) {
+
+	std::string name = path.filename().string();
+
+	std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+
+	return name == "definition.csv";
+
+}
+
+std::vector<std::string> expandDefinitionInputs(const std::vector<std::string> &inputs) {
+
+	std::vector<std::string> files;
+
+	for (const std::string &input : inputs) {
+
+		std::error_code error;
+
+		if (!std::filesystem::is_directory(input, error)) {
+			if (!std::filesystem::is_regular_file(input, error))
+				throw std::runtime_error("Cannot open " + input + ".");
+			files.push_back(input);
+			continue;
+		}
+
+		std::vector<std::string> found;
+
+		for (const auto &entry : std::filesystem::recursive_directory_iterator(input, std::filesystem::directory_options::skip_permission_denied)) {
+			if (entry.is_regular_file() && isDefinitionFile(entry.path()))
+				found.push_back(entry.path().string());
+		}
+
+		if (found.empty())
+			throw std::runtime_error("No definition.csv found under " + input + ".");
+
+		std::sort(found.begin(), found.end());
+		files.insert(files.end(), found.begin(), found.end());
+
+	}
+
+	return files;
+
+}
+
+/*
+	Workers claim files through an atomic index, largest first so one big file does not start last.
+	The first error (in input order) is rethrown once every worker has stopped.
+*/
+
+std::vector<ReservedSource> loadReservedSources(const std::vector<std::string> &paths, bool useCache, unsigned int threads) {
+
+	std::vector<ReservedSource> sources(paths.size());
+	std::vector<std::exception_ptr> errors(paths.size());
+	std::vector<size_t> order(paths.size());
+	std::vector<uintmax_t> sizes(paths.size());
+	std::atomic<size_t> next(0);
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		std::error_code missing;
+		sizes[i] = std::filesystem::file_size(paths[i], missing);
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	threads = (unsigned int)std::min<size_t>(threads, paths.size());
+
+	auto worker = [&]() {
+		for (size_t claimed = next++; claimed < order.size(); claimed = next++) {
+			size_t i = order[claimed];
+			sources[i].path = paths[i];
+			try {
+				sources[i].set = loadReservedSet(paths[i], useCache);
+			}
+			catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	StageTimer stage("load sources");
+	std::vector<std::thread> pool;
+
+	for (unsigned int i = 1; i < threads; i++)
+		pool.push_back(std::thread(worker));
+
+	worker();
+
+	for (size_t i = 0; i < pool.size(); i++)
+		pool[i].join();
+
+	for (size_t i = 0; i < errors.size(); i++) {
+		if (errors[i])
+			std::rethrow_exception(errors[i]);
+	}
+
+	return sources;
+
+}
+
+ReservedSet mergeReservedSources(const std::vector<ReservedSource> &sources) {
+
+	if (sources.size() == 1)
+		return sources[0].set;
+
+	ReservedSet merged;
+	StageTimer stage("merge");
+
+	merged.cacheStatus.clear();
+
+	for (const ReservedSource &source : sources) {
+		merged.bitmap.merge(source.set.bitmap);
+		merged.maxProvinceId = std::max(merged.maxProvinceId, source.set.maxProvinceId);
+		if (merged.cacheStatus.find(source.set.cacheStatus) == std::string::npos)
+			merged.cacheStatus += (merged.cacheStatus.empty() ? "" : ", ") + source.set.cacheStatus;
+	}
+
+	merged.provinceCount = merged.bitmap.count();
+
+	return merged;
+
+}
+
+/*Colors of bitmap word w that more than one source reserves: a bit seen in an earlier source and set again.*/
+
+static uint64_t sharedBits(const std::vector<ReservedSource> &sources, size_t w) {
+
+	uint64_t seen = 0;
+	uint64_t shared = 0;
+
+	for (const ReservedSource &source : sources) {
+		shared |= seen & source.set.bitmap.words[w];
+		seen |= source.set.bitmap.words[w];
+	}
+
+	return shared;
+
+}
+
+unsigned long countCollisions(const std::vector<ReservedSource> &sources) {
+
+	unsigned long total = 0;
+
+	for (size_t w = 0; w < COLOR_SPACE_SIZE / 64; w++)
+		total += popCount64(sharedBits(sources, w));
+
+	return total;
+
+}
+
+/*Owners are only looked up for the shared colors.*/
+
+std::vector<ColorCollision> findCollisions(const std::vector<ReservedSource> &sources) {
+
+	std::vector<ColorCollision> collisions;
+
+	for (size_t w = 0; w < COLOR_SPACE_SIZE / 64; w++) {
+
+		for (uint64_t shared = sharedBits(sources, w); shared != 0; shared &= shared - 1) {
+
+			ColorCollision collision;
+			collision.color = (Color)(w * 64 + lowestBit64(shared));
+
+			for (size_t i = 0; i < sources.size(); i++) {
+				if (sources[i].set.bitmap.test(collision.color))
+					collision.owners.push_back(i);
+			}
+
+			collisions.push_back(collision);
+
+		}
+
+	}
+
+	return collisions;
+
+}
+
+void writeCollisionReport(const std::string &path, const std::vector<ReservedSource> &sources, const std::vector<ColorCollision> &collisions) {
+
+	std::ofstream out(path);
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+	for (const ColorCollision &collision : collisions) {
+		out << "(" << redOf(collision.color) << ", " << greenOf(collision.color) << ", " << blueOf(collision.color) << ") "
+			<< std::hex << std::setw(6) << std::setfill('0') << collision.color << std::dec << ":";
+		for (size_t i = 0; i < collision.owners.size(); i++)
+			out << (i == 0 ? " " : ", ") << sources[collision.owners[i]].path;
+		out << '\n';
+	}
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+}
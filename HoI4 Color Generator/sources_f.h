@@ -0,0 +1,64 @@
+#pragma once
+
+#include "cache_f.h"
+
+#include <string>
+#include <vector>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Reserved sets built from several definition files, for mods split into submods or overlays.
+
+expandDefinitionInputs turns the --input arguments into a list of files. A file is taken as is. A directory is searched recursively
+for files named definition.csv (any case), in sorted order. Throws std::runtime_error for a missing path or a directory without one.
+
+loadReservedSources loads every file on up to `threads` threads (0 uses every core), each through loadReservedSet with its own cache,
+so the wall time is close to that of the largest file. Sources keep their own bitmaps so collisions can be traced back to files.
+mergeReservedSources ORs the sources into one set. provinceCount is the number of distinct reserved colors when there is more than one source,
+and maxProvinceId the highest ID of any source.
+
+countCollisions counts the colors reserved by more than one source. findCollisions lists them reserved by more than one source, in color order, with the indices of the sources that reserve each.
+writeCollisionReport writes them one per line as "(R, G, B) hex: file, file". Throws std::runtime_error if the file cannot be written.
+*/
+
+struct ReservedSource {
+	std::string path;
+	ReservedSet set;
+};
+
+struct ColorCollision {
+	Color color;
+	std::vector<size_t> owners;
+};
+
+std::vector<std::string> expandDefinitionInputs(const std::vector<std::string> &inputs);
+
+std::vector<ReservedSource> loadReservedSources(const std::vector<std::string> &paths, bool useCache = true, unsigned int threads = 0);
+
+ReservedSet mergeReservedSources(const std::vector<ReservedSource> &sources);
+
+unsigned long countCollisions(const std::vector<ReservedSource> &sources);
+
+std::vector<ColorCollision> findCollisions(const std::vector<ReservedSource> &sources);
+
+void writeCollisionReport(const std::string &path, const std::vector<ReservedSource> &sources, const std::vector<ColorCollision> &collisions);
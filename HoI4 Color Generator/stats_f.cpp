@@ -0,0 +1,275 @@
+#include "stats_f.h"
+#include "generator_f.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+namespace {
+
+const size_t MAX_STAGE_NAMES = 64;			// Rows of the stage table; further names are totalled under "other".
+const size_t MAX_TRACE_EVENTS = 10000;		// Stage runs kept for --trace; later ones are only counted.
+
+struct StageTotal {
+	std::string name;
+	uint64_t runs;
+	double seconds;
+	double maxSeconds;
+};
+
+struct StageTiming {
+	std::string name;
+	double start;
+	double seconds;
+};
+
+/* Memory stays bounded however many stages a long-running server records. */
+
+struct StatsState {
+	std::mutex lock;
+	std::vector<StageTotal> totals;
+	std::vector<StageTiming> events;
+	uint64_t droppedEvents = 0;
+	GenerationCounters counters;
+	bool countersRecorded = false;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+};
+
+StatsState &stats() {
+	static StatsState state;
+	return state;
+}
+
+/*Minimal JSON string escaping for stage names.*/
+
+std::string jsonString(const std::string &text) {
+
+	std::string quoted = "\"";
+
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+
+	return quoted + "\"";
+
+}
+
+}
+
+GenerationCounters &GenerationCounters::operator+=(const GenerationCounters &other) {
+
+	examined += other.examined;
+	accepted += other.accepted;
+	surplus += other.surplus;
+	rejectedReserved += other.rejectedReserved;
+	rejectedContrast += other.rejectedContrast;
+
+	return *this;
+
+}
+
+double secondsSinceStart() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - stats().start).count();
+}
+
+void recordStage(const std::string &name, double start, double seconds) {
+
+	StatsState &state = stats();
+	std::lock_guard<std::mutex> guard(state.lock);
+
+	size_t i = 0;
+
+	while (i < state.totals.size() && state.totals[i].name != name)
+		i++;
+
+	if (i == state.totals.size()) {
+		if (state.totals.size() < MAX_STAGE_NAMES - 1)
+			state.totals.push_back({ name, 0, 0, 0 });
+		else if (state.totals.size() == MAX_STAGE_NAMES - 1)
+			state.totals.push_back({ "other", 0, 0, 0 });
+		else
+			i = MAX_STAGE_NAMES - 1;
+	}
+
+	state.totals[i].runs++;
+	state.totals[i].seconds += seconds;
+	state.totals[i].maxSeconds = std::max(state.totals[i].maxSeconds, seconds);
+
+	if (state.events.size() < MAX_TRACE_EVENTS)
+		state.events.push_back({ name, start, seconds });
+	else
+		state.droppedEvents++;
+
+}
+
+void recordCounters(const GenerationCounters &counters) {
+
+	StatsState &state = stats();
+	std::lock_guard<std::mutex> guard(state.lock);
+
+	state.counters += counters;
+	state.countersRecorded = true;
+
+}
+
+/*Peak resident set size of the process. 0 where the platform does not report it.*/
+
+uint64_t peakMemoryBytes() {
+
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memory;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory)))
+		return 0;
+	return (uint64_t)memory.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return (uint64_t)usage.ru_maxrss;
+#else
+	return (uint64_t)usage.ru_maxrss * 1024;	// Kilobytes on Linux and the BSDs.
+#endif
+#endif
+
+}
+
+/*Human-readable summary. Stages that ran more than once (batch jobs, server requests) are totalled under one line.*/
+
+void printStats(std::ostream &out) {
+
+	StatsState &state = stats();
+	std::lock_guard<std::mutex> guard(state.lock);
+
+	std::ios_base::fmtflags flags = out.flags();
+
+	out << std::endl << "Stage timings:" << std::endl;
+	out << std::fixed << std::setprecision(3);
+
+	for (const StageTotal &stage : state.totals) {
+		out << "  " << std::left << std::setw(16) << stage.name << std::right << std::setw(12) << stage.seconds * 1000 << " ms";
+		if (stage.runs > 1)
+			out << " (" << stage.runs << " runs, longest " << stage.maxSeconds * 1000 << " ms)";
+		out << std::endl;
+	}
+
+	out << "  " << std::left << std::setw(16) << "total" << std::right << std::setw(12) << secondsSinceStart() * 1000 << " ms" << std::endl;
+
+	const GenerationCounters &counters = state.counters;
+
+	/* Runs that generate nothing, such as an audit without --repair, have no counters to show. */
+
+	if (state.countersRecorded) {
+		out << "Colors examined:      " << counters.examined << std::endl;
+		out << "  accepted:           " << counters.accepted << std::endl;
+		out << "  surplus:            " << counters.surplus << std::endl;
+		out << "  rejected, reserved: " << counters.rejectedReserved << std::endl;
+		out << "  rejected, contrast: " << counters.rejectedContrast << std::endl;
+	}
+	out << "Peak memory:          " << std::setprecision(1) << peakMemoryBytes() / 1048576.0 << " MiB" << std::endl;
+
+	out.flags(flags);
+
+}
+
+/*
+	Chrome trace event format, so the file opens in chrome://tracing or Perfetto: one complete ("X") event per stage, in microseconds,
+	and the counters as a counter ("C") event at the end. otherData repeats the counters and peak memory for scripts, and counts the stage
+	runs past the first MAX_TRACE_EVENTS, which are left out.
+*/
+
+void writeTrace(const std::string &path) {
+
+	std::ofstream out(path, std::ios::binary);
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+	StatsState &state = stats();
+	std::lock_guard<std::mutex> guard(state.lock);
+
+	const GenerationCounters &counters = state.counters;
+	double end = secondsSinceStart();
+
+	std::string counterFields =
+		"\"examined\":" + std::to_string(counters.examined) +
+		",\"accepted\":" + std::to_string(counters.accepted) +
+		",\"surplus\":" + std::to_string(counters.surplus) +
+		",\"rejected_reserved\":" + std::to_string(counters.rejectedReserved) +
+		",\"rejected_contrast\":" + std::to_string(counters.rejectedContrast);
+
+	out << std::fixed << std::setprecision(1);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+
+	for (const StageTiming &stage : state.events) {
+		out << "{\"name\":" << jsonString(stage.name) << ",\"cat\":\"stage\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << stage.start * 1e6
+			<< ",\"dur\":" << stage.seconds * 1e6 << "}," << std::endl;
+	}
+
+	out << "{\"name\":\"colors\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":" << end * 1e6 << ",\"args\":{" << counterFields << "}}" << std::endl;
+	out << "],\"otherData\":{" << counterFields << ",\"peak_memory_bytes\":" << peakMemoryBytes() << ",\"dropped_events\":" << state.droppedEvents << ",\"total_ms\":" << end * 1000 << "}}" << std::endl;
+
+	if (!out)
+		throw std::runtime_error("Could not write " + path + ".");
+
+}
+
+ProgressMeter::~ProgressMeter() {
+
+	if (lastPercent >= 0 && lastPercent < 100)
+		progressOutput() << "100%\r" << std::flush;
+
+}
+
+void ProgressMeter::advance(uint64_t steps) {
+
+	done += steps;
+
+	if (total == 0)
+		return;
+
+	int percent = (int)(done * 100 / total);
+	double now = secondsSinceStart();
+
+	if (percent != lastPercent && now - lastPrint >= 0.1) {
+		progressOutput() << percent << "%\r" << std::flush;
+		lastPercent = percent;
+		lastPrint = now;
+	}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Run instrumentation: wall time per stage, generation counters, and peak memory, reported by --stats and --trace.
+
+Stages are timed with a StageTimer around the work. Generators add their GenerationCounters once per shard, not per color.
+Generation walks only the free colors of the clamp box, so a color is never rejected for lying outside the box or for repeating an earlier one;
+every color of the box the scan passes is reserved, dropped by the contrast (or delta E) filter, accepted, or surplus.
+Stage runs are totalled by name in a fixed-size table (runs, total and longest time), so a server recording stages for every request stays bounded;
+only the first runs are kept individually, for the trace. All recording functions are thread-safe.
+*/
+
+struct GenerationCounters {
+	uint64_t examined = 0;				// Colors of the clamp box the scan passed over.
+	uint64_t accepted = 0;				// Colors in the output.
+	uint64_t surplus = 0;				// Passed the filters in a shard but fell past the requested count at the merge.
+	uint64_t rejectedReserved = 0;
+	uint64_t rejectedContrast = 0;		// Too close to the previous color in luminance, or to any earlier color in CIELAB.
+
+	GenerationCounters &operator+=(const GenerationCounters &other);
+};
+
+double secondsSinceStart();
+
+void recordStage(const std::string &name, double start, double seconds);
+
+void recordCounters(const GenerationCounters &counters);
+
+uint64_t peakMemoryBytes();
+
+void printStats(std::ostream &out);
+
+void writeTrace(const std::string &path);
+
+class StageTimer {
+
+public:
+
+	explicit StageTimer(const std::string &name) : name(name), start(secondsSinceStart()) {}
+	~StageTimer() { recordStage(name, start, secondsSinceStart() - start); }
+
+	StageTimer(const StageTimer &) = delete;
+	StageTimer &operator=(const StageTimer &) = delete;
+
+private:
+
+	std::string name;
+	double start;
+
+};
+
+/*
+Percentage printout for long loops. Prints "N%" to progressOutput at most every tenth of a second instead of once per step, starting a tenth of a second in,
+and 100% when destroyed if anything was printed. Not thread-safe; advance it under the caller's lock.
+*/
+
+class ProgressMeter {
+
+public:
+
+	explicit ProgressMeter(uint64_t total) : total(total), done(0), lastPercent(-1), lastPrint(secondsSinceStart()) {}
+	~ProgressMeter();
+
+	void advance(uint64_t steps = 1);
+
+private:
+
+	uint64_t total;
+	uint64_t done;
+	int lastPercent;
+	double lastPrint;
+
+};
@@ -0,0 +1,130 @@
+#include "stream_f.h"
+#include "luminance_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+ColorStream::ColorStream(const ColorBitmap &reserved, const short *clampVals, short mContrast)
+	: reserved(reserved), mContrast(mContrast), nextRed(clampVals[0]), nextGreen(clampVals[1]), rowBase(0), word(4), lastLuminance(-1) {
+
+	std::copy(clampVals, clampVals + 6, this->clampVals);
+	std::fill(mask, mask + 4, 0);
+
+}
+
+/*
+	Move to the next row of the box that holds a free color. Rows without one are counted and skipped.
+	The contrast chain runs on across rows and red values, as in generateShardedValues.
+*/
+
+bool ColorStream::loadRow() {
+
+	int width = clampVals[5] - clampVals[2] + 1;
+
+	while (nextRed <= clampVals[3]) {
+
+		int r = nextRed;
+		int g = nextGreen;
+
+		if (++nextGreen > clampVals[4]) {
+			nextGreen = clampVals[1];
+			nextRed++;
+		}
+
+		freeRowMask(reserved, r, g, clampVals, mask);
+
+		int rowFree = popCount64(mask[0]) + popCount64(mask[1]) + popCount64(mask[2]) + popCount64(mask[3]);
+
+		counts.examined += width;
+		counts.rejectedReserved += width - rowFree;
+
+		if (rowFree == 0)
+			continue;
+
+		rowBase = packColor(r, g, 0);
+		word = 0;
+
+		if (mContrast > 1) {
+			Color row[256];
+			for (int blue = 0; blue < 256; blue++)
+				row[blue] = rowBase | blue;
+			batchLuminance(row, 256, rowLuminance);
+		}
+
+		return true;
+
+	}
+
+	return false;
+
+}
+
+/*Copy up to count further colors into out. Returns how many were written; fewer than count only when the box runs out.*/
+
+size_t ColorStream::next(Color *out, size_t count) {
+
+	size_t taken = 0;
+
+	while (taken < count) {
+
+		if (word == 4 && !loadRow())
+			break;
+
+		uint64_t &bits = mask[word];
+
+		while (bits != 0 && taken < count) {
+
+			int b = 64 * word + lowestBit64(bits);
+			bits &= bits - 1;
+
+			if (mContrast > 1) {
+				if (lastLuminance >= 0 && std::abs(rowLuminance[b] - lastLuminance) < mContrast) {
+					counts.rejectedContrast++;
+					continue;
+				}
+				lastLuminance = rowLuminance[b];
+			}
+
+			out[taken++] = rowBase | b;
+
+		}
+
+		if (bits == 0)
+			word++;
+
+	}
+
+	counts.accepted += taken;
+
+	return taken;
+
+}
+
+GenerationCounters ColorStream::counters() const {
+
+	GenerationCounters result = counts;
+
+	for (int w = word; w < 4; w++)
+		result.examined -= popCount64(mask[w]);
+
+	return result;
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "generator_f.h"
+#include "stats_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+ColorStream hands out the free colors of a clamp box in chunks, in the same packed order and with the same contrast rule as generateUnreservedValues,
+so its first n colors are exactly what generateUnreservedValues(n) returns. The stream holds one row mask and cursor (about 300 bytes) rather than a list,
+so memory use does not grow with the number of colors taken; next() returns 0 once the box is exhausted.
+The reserved bitmap is read in place and must outlive the stream and stay unchanged while it is used.
+*/
+
+class ColorStream {
+
+public:
+
+	ColorStream(const ColorBitmap &reserved, const short *clampVals, short mContrast = 1);
+
+	size_t next(Color *out, size_t count);
+
+	/*Counters for the colors streamed so far. Free colors of the current row that were not reached yet are not counted as examined.*/
+	GenerationCounters counters() const;
+
+private:
+
+	bool loadRow();
+
+	const ColorBitmap &reserved;
+	short clampVals[6];
+	short mContrast;
+	int nextRed;
+	int nextGreen;
+	Color rowBase;
+	uint64_t mask[4];
+	int word;
+	int lastLuminance;
+	unsigned char rowLuminance[256];
+	GenerationCounters counts;
+
+};
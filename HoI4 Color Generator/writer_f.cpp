@@ -0,0 +1,266 @@
+#include "writer_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+static const size_t WRITE_BUFFER_SIZE = 1 << 20;		// Bytes formatted before each write to disk.
+static const size_t MAX_COLOR_LENGTH = 64;				// Longest formatted color, excluding definition fields.
+
+static_assert(MAX_COLOR_LENGTH + MAX_DEFINITION_FIELDS_LENGTH <= WRITE_BUFFER_SIZE, "A definition row must fit in the write buffer.");
+
+/*Decimal text of every channel value, built once.*/
+
+struct ChannelText {
+
+	char digits[256][3];
+	unsigned char length[256];
+
+	ChannelText() {
+		for (int i = 0; i < 256; i++) {
+			int n = 0;
+			if (i >= 100)
+				digits[i][n++] = (char)('0' + i / 100);
+			if (i >= 10)
+				digits[i][n++] = (char)('0' + i / 10 % 10);
+			digits[i][n++] = (char)('0' + i % 10);
+			length[i] = (unsigned char)n;
+		}
+	}
+
+};
+
+static const ChannelText channelText;
+static const char hexDigits[] = "0123456789abcdef";
+
+static inline char *putChannel(char *out, unsigned int value) {
+	memcpy(out, channelText.digits[value], 3);
+	return out + channelText.length[value];
+}
+
+/*Six hex digits, optionally without leading zeros (matching std::hex).*/
+
+static inline char *putHex(char *out, Color color, bool padded) {
+
+	int shift = 20;
+
+	if (!padded) {
+		while (shift > 0 && ((color >> shift) & 0xf) == 0)
+			shift -= 4;
+	}
+
+	for (; shift >= 0; shift -= 4)
+		*out++ = hexDigits[(color >> shift) & 0xf];
+
+	return out;
+
+}
+
+static inline char *putLong(char *out, long value) {
+
+	char digits[24];
+	int n = 0;
+
+	if (value < 0) {
+		*out++ = '-';
+		value = -value;
+	}
+
+	do {
+		digits[n++] = (char)('0' + value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while (n > 0)
+		*out++ = digits[--n];
+
+	return out;
+
+}
+
+OutputFormat parseOutputFormat(const std::string &name) {
+
+	if (name == "text")
+		return OutputFormat::Text;
+	if (name == "definition")
+		return OutputFormat::Definition;
+	if (name == "json")
+		return OutputFormat::Json;
+	if (name == "binary")
+		return OutputFormat::Binary;
+
+	throw std::runtime_error("Unknown output format \"" + name + "\". Use text, definition, json or binary.");
+
+}
+
+ColorWriter::ColorWriter(const std::string &path, OutputFormat format, long firstProvinceId, const std::string &definitionFields)
+	: path(path), file(NULL), format(format), nextProvinceId(firstProvinceId), definitionFields(definitionFields), buffer(WRITE_BUFFER_SIZE), used(0), firstColor(true) {
+
+	/* write reserves room for a whole row at a time, so the fields must fit the buffer, and a line break would split the row. */
+
+	if (definitionFields.size() > MAX_DEFINITION_FIELDS_LENGTH)
+		throw std::runtime_error("Definition fields are limited to " + std::to_string(MAX_DEFINITION_FIELDS_LENGTH) + " characters.");
+
+	if (definitionFields.find_first_of("\r\n") != std::string::npos)
+		throw std::runtime_error("Definition fields cannot contain line breaks.");
+
+	file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL)
+		throw std::runtime_error("Cannot write " + path + ".");
+
+	/* Whole blocks are handed to the OS directly; the stdio buffer would only add a copy. */
+
+	std::setvbuf(file, NULL, _IONBF, 0);
+
+	if (format == OutputFormat::Text)
+		append("(R, G, B)\n", 10);
+	else if (format == OutputFormat::Json)
+		append("[", 1);
+
+}
+
+ColorWriter::~ColorWriter() {
+
+	try {
+		finish();
+	}
+	catch (...) {
+	}
+
+}
+
+void ColorWriter::flushBuffer() {
+
+	if (used > 0 && std::fwrite(buffer.data(), 1, used, file) != used)
+		throw std::runtime_error("Could not write to " + path + ".");
+
+	used = 0;
+
+}
+
+void ColorWriter::append(const char *text, size_t length) {
+
+	if (used + length > buffer.size())
+		flushBuffer();
+
+	memcpy(buffer.data() + used, text, length);
+	used += length;
+
+}
+
+void ColorWriter::write(const Color *colors, size_t count) {
+
+	size_t rowLimit = MAX_COLOR_LENGTH + definitionFields.size();
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (used + rowLimit > buffer.size())
+			flushBuffer();
+
+		Color color = colors[i];
+		char *start = buffer.data() + used;
+		char *out = start;
+
+		switch (format) {
+		case OutputFormat::Text:
+			*out++ = '(';
+			out = putChannel(out, redOf(color));
+			*out++ = ','; *out++ = ' ';
+			out = putChannel(out, greenOf(color));
+			*out++ = ','; *out++ = ' ';
+			out = putChannel(out, blueOf(color));
+			*out++ = ')'; *out++ = ' ';
+			out = putHex(out, color, false);
+			*out++ = '\n';
+			break;
+		case OutputFormat::Definition:
+			out = putLong(out, nextProvinceId++);
+			*out++ = ';';
+			out = putChannel(out, redOf(color));
+			*out++ = ';';
+			out = putChannel(out, greenOf(color));
+			*out++ = ';';
+			out = putChannel(out, blueOf(color));
+			*out++ = ';';
+			memcpy(out, definitionFields.data(), definitionFields.size());
+			out += definitionFields.size();
+			*out++ = '\n';
+			break;
+		case OutputFormat::Json:
+			if (!firstColor)
+				*out++ = ',';
+			memcpy(out, "\n{\"r\":", 6);
+			out = putChannel(out + 6, redOf(color));
+			memcpy(out, ",\"g\":", 5);
+			out = putChannel(out + 5, greenOf(color));
+			memcpy(out, ",\"b\":", 5);
+			out = putChannel(out + 5, blueOf(color));
+			memcpy(out, ",\"hex\":\"#", 9);
+			out = putHex(out + 9, color, true);
+			*out++ = '"'; *out++ = '}';
+			break;
+		case OutputFormat::Binary:
+			*out++ = (char)redOf(color);
+			*out++ = (char)greenOf(color);
+			*out++ = (char)blueOf(color);
+			break;
+		}
+
+		used += out - start;
+		firstColor = false;
+
+	}
+
+}
+
+void ColorWriter::finish() {
+
+	if (file == NULL)
+		return;
+
+	try {
+		if (format == OutputFormat::Json)
+			append("\n]\n", 3);
+		flushBuffer();
+	}
+	catch (...) {
+		std::fclose(file);
+		file = NULL;
+		throw;
+	}
+
+	bool closed = std::fclose(file) == 0;
+	file = NULL;
+
+	if (!closed)
+		throw std::runtime_error("Could not write to " + path + ".");
+
+}
+
+/*Write a whole color list in one of the output formats.*/
+
+void writeColors(const ColorList &values, const std::string &path, OutputFormat format, long firstProvinceId, const std::string &definitionFields) {
+
+	ColorWriter writer(path, format, firstProvinceId, definitionFields);
+	writer.write(values.data(), values.size());
+	writer.finish();
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "generator_f.h"
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+OutputFormat selects what ColorWriter produces:
+Text is the classic "(R, G, B) hex" list. Definition is ready-to-append definition.csv rows with sequential province IDs.
+Json is an array of objects. Binary is three raw bytes (R, G, B) per color with no header.
+*/
+
+enum class OutputFormat { Text, Definition, Json, Binary };
+
+OutputFormat parseOutputFormat(const std::string &name);
+
+/*
+ColorWriter streams colors to a file. Colors are formatted into a large buffer with table-driven integer and hex formatting,
+and the buffer goes to disk in whole blocks. Call write as often as needed, then finish (the destructor also finishes).
+Throws std::runtime_error if the file cannot be written, or if definitionFields is longer than MAX_DEFINITION_FIELDS_LENGTH or holds a line break.
+*/
+
+const size_t MAX_DEFINITION_FIELDS_LENGTH = 4096;
+
+class ColorWriter {
+
+public:
+
+	ColorWriter(const std::string &path, OutputFormat format, long firstProvinceId = 1, const std::string &definitionFields = "land;false;plains;1");
+	~ColorWriter();
+
+	ColorWriter(const ColorWriter &) = delete;
+	ColorWriter &operator=(const ColorWriter &) = delete;
+
+	void write(const Color *colors, size_t count);
+	void finish();
+
+private:
+
+	void flushBuffer();
+	void append(const char *text, size_t length);
+
+	std::string path;
+	FILE *file;
+	OutputFormat format;
+	long nextProvinceId;
+	std::string definitionFields;
+	std::vector<char> buffer;
+	size_t used;
+	bool firstColor;
+
+};
+
+void writeColors(const ColorList &values, const std::string &path, OutputFormat format, long firstProvinceId = 1, const std::string &definitionFields = "land;false;plains;1");
@@ -0,0 +1,456 @@
+#include "synthetic_definition.h"
+#include "generator_f.h"
+#include "definition_f.h"
+#include "perceptual_f.h"
+#include "writer_f.h"
+#include "image_f.h"
+#include "cache_f.h"
+#include "allocator_f.h"
+#include "permutation_f.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Microbenchmarks for each stage of a run: parse definition.csv, index the reserved colors, generate, sort and write.
+Reserved sets come from synthetic definition.csv files (see synthetic_definition.h) written to the temp directory
+on first use and removed on exit. Pass --benchmark_format=json or --benchmark_out=FILE for machine-readable results.
+*/
+
+namespace {
+
+std::vector<std::string> scratchFiles;
+
+std::string scratchPath(const std::string &name) {
+
+	std::string path = (std::filesystem::temp_directory_path() / ("ccf_benchmark_" + name)).string();
+
+	scratchFiles.push_back(path);
+
+	return path;
+
+}
+
+void removeScratchFiles() {
+
+	std::error_code ignored;
+
+	for (const std::string &path : scratchFiles)
+		std::filesystem::remove(path, ignored);
+
+}
+
+/*Synthetic definition.csv with the given number of rows, written once per process.*/
+
+const std::string &syntheticDefinition(long rows) {
+
+	static std::map<long, std::string> paths;
+
+	auto found = paths.find(rows);
+
+	if (found != paths.end())
+		return found->second;
+
+	std::string path = scratchPath(std::to_string(rows) + ".csv");
+
+	writeSyntheticDefinition(path, (unsigned long)rows);
+
+	return paths[rows] = path;
+
+}
+
+const ColorList &reservedList(long rows) {
+
+	static std::map<long, ColorList> lists;
+
+	auto found = lists.find(rows);
+
+	if (found != lists.end())
+		return found->second;
+
+	return lists[rows] = getReservedList(syntheticDefinition(rows));
+
+}
+
+const ColorBitmap &reservedBitmap(long rows) {
+
+	static std::map<long, ColorBitmap> bitmaps;
+
+	auto found = bitmaps.find(rows);
+
+	if (found != bitmaps.end())
+		return found->second;
+
+	return bitmaps[rows] = hashReservedList(reservedList(rows));
+
+}
+
+/*Free colors for the sort and write stages, taken against a map-sized reserved set.*/
+
+const ColorList &freeColors(long pCount) {
+
+	static std::map<long, ColorList> lists;
+
+	auto found = lists.find(pCount);
+
+	if (found != lists.end())
+		return found->second;
+
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+
+	return lists[pCount] = generateUnreservedValues(reservedBitmap(13000), pCount, 1, clampVals);
+
+}
+
+/*Clamp box of the given edge length in the middle of the cube.*/
+
+void centeredClamp(long edge, short *clampVals) {
+
+	short low = (short)((256 - edge) / 2);
+
+	for (int i = 0; i < 3; i++) {
+		clampVals[i] = low;
+		clampVals[i + 3] = (short)(low + edge - 1);
+	}
+
+}
+
+const long RESERVED_ROWS[] = { 1000, 13000, 100000, 1000000, 4000000 };
+
+/*Parse: definition.csv text to a list of colors. Arg: rows.*/
+
+void BM_ParseDefinition(benchmark::State &state) {
+
+	const std::string &path = syntheticDefinition(state.range(0));
+
+	for (auto _ : state) {
+		ColorList values = getReservedList(path);
+		benchmark::DoNotOptimize(values.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	state.SetBytesProcessed(state.iterations() * (int64_t)std::filesystem::file_size(path));
+
+}
+
+/*Index: reserved list to bitmap. Arg: rows.*/
+
+void BM_IndexReserved(benchmark::State &state) {
+
+	const ColorList &values = reservedList(state.range(0));
+
+	for (auto _ : state) {
+		ColorBitmap reserved = hashReservedList(values);
+		benchmark::DoNotOptimize(reserved.words.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * (int64_t)values.size());
+
+}
+
+/*Cached load: what a second run against an unchanged definition.csv pays for parse + index. Arg: rows.*/
+
+void BM_LoadCachedReservedSet(benchmark::State &state) {
+
+	const std::string &path = syntheticDefinition(state.range(0));
+
+	scratchFiles.push_back(path + ".cache");
+	loadReservedSet(path, true);
+
+	for (auto _ : state) {
+		ReservedSet reserved = loadReservedSet(path, true);
+		benchmark::DoNotOptimize(reserved.bitmap.words.data());
+	}
+
+}
+
+/*Generate with the single-threaded engine. Args: pCount, contrast, clamp box edge, reserved rows.*/
+
+void BM_Generate(benchmark::State &state) {
+
+	long pCount = (long)state.range(0);
+	short contrast = (short)state.range(1);
+	short clampVals[6];
+
+	centeredClamp(state.range(2), clampVals);
+
+	const ColorBitmap &reserved = reservedBitmap(state.range(3));
+
+	try {
+		for (auto _ : state) {
+			ColorList values = generateUnreservedValues(reserved, pCount, contrast, clampVals);
+			benchmark::DoNotOptimize(values.data());
+		}
+	}
+	catch (const std::exception &e) {
+		state.SkipWithError(e.what());
+		return;
+	}
+
+	state.SetItemsProcessed(state.iterations() * pCount);
+
+}
+
+/*Generate with sharded workers. Args: pCount, threads.*/
+
+void BM_GenerateSharded(benchmark::State &state) {
+
+	long pCount = (long)state.range(0);
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+
+	const ColorBitmap &reserved = reservedBitmap(13000);
+
+	for (auto _ : state) {
+		ColorList values = generateShardedValues(reserved, pCount, 1, clampVals, (unsigned int)state.range(1));
+		benchmark::DoNotOptimize(values.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * pCount);
+
+}
+
+/*Generate in seeded permutation order. Args: pCount, contrast.*/
+
+void BM_GenerateSeeded(benchmark::State &state) {
+
+	long pCount = (long)state.range(0);
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+
+	const ColorBitmap &reserved = reservedBitmap(13000);
+
+	for (auto _ : state) {
+		ColorList values = generateSeededValues(reserved, pCount, (short)state.range(1), clampVals, 1);
+		benchmark::DoNotOptimize(values.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * pCount);
+
+}
+
+/*Generate with a CIELAB distance guarantee. Args: pCount, delta E * 10.*/
+
+void BM_GeneratePerceptual(benchmark::State &state) {
+
+	long pCount = (long)state.range(0);
+	short clampVals[6] = { 0, 0, 0, 255, 255, 255 };
+
+	const ColorBitmap &reserved = reservedBitmap(13000);
+
+	try {
+		for (auto _ : state) {
+			ColorList values = generatePerceptualValues(reserved, pCount, state.range(1) / 10.0, clampVals);
+			benchmark::DoNotOptimize(values.data());
+		}
+	}
+	catch (const std::exception &e) {
+		state.SkipWithError(e.what());
+		return;
+	}
+
+	state.SetItemsProcessed(state.iterations() * pCount);
+
+}
+
+/*Sort by luminance. Arg: pCount.*/
+
+void BM_LuminanceSort(benchmark::State &state) {
+
+	const ColorList &values = freeColors(state.range(0));
+
+	for (auto _ : state) {
+		state.PauseTiming();
+		ColorList sorted = values;
+		state.ResumeTiming();
+		luminanceSort(sorted);
+		benchmark::DoNotOptimize(sorted.data());
+	}
+
+	state.SetItemsProcessed(state.iterations() * (int64_t)values.size());
+
+}
+
+/*Write the color list. Args: pCount, OutputFormat.*/
+
+void BM_WriteColors(benchmark::State &state) {
+
+	const ColorList &values = freeColors(state.range(0));
+	OutputFormat format = (OutputFormat)state.range(1);
+	std::string path = scratchPath("colors_" + std::to_string(state.range(1)) + ".out");
+
+	for (auto _ : state)
+		writeColors(values, path, format);
+
+	state.SetItemsProcessed(state.iterations() * (int64_t)values.size());
+	state.SetBytesProcessed(state.iterations() * (int64_t)std::filesystem::file_size(path));
+
+}
+
+/*Write the preview image. Args: pCount, 0 for BMP or 1 for PNG.*/
+
+void BM_WriteImage(benchmark::State &state) {
+
+	const ColorList &values = freeColors(state.range(0));
+	std::string path = scratchPath(state.range(1) ? "image.png" : "image.bmp");
+
+	for (auto _ : state)
+		writeImage(values, path);
+
+	state.SetItemsProcessed(state.iterations() * (int64_t)values.size());
+	state.SetBytesProcessed(state.iterations() * (int64_t)std::filesystem::file_size(path));
+
+}
+
+/*
+	Concurrent allocation: every thread takes colors one at a time from its own cursor and returns them, so the pool never runs dry.
+	Arg: colors per batch.
+*/
+
+ColorAllocator *sharedAllocator = NULL;
+
+void BM_AllocatorThroughput(benchmark::State &state) {
+
+	if (state.thread_index() == 0)
+		sharedAllocator = new ColorAllocator(reservedBitmap(13000));
+
+	std::vector<Color> batch((size_t)state.range(0));
+	ColorAllocator::Cursor cursor;
+	bool started = false;
+
+	for (auto _ : state) {
+
+		if (!started) {
+			cursor = sharedAllocator->cursor(state.thread_index(), state.threads());
+			started = true;
+		}
+
+		for (Color &color : batch)
+			sharedAllocator->allocate(cursor, color);
+
+		for (Color color : batch)
+			sharedAllocator->release(color);
+
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+
+	if (state.thread_index() == 0) {
+		delete sharedAllocator;
+		sharedAllocator = NULL;
+	}
+
+}
+
+void reservedRowArgs(benchmark::internal::Benchmark *bench) {
+
+	for (long rows : RESERVED_ROWS)
+		bench->Arg(rows);
+
+}
+
+}
+
+BENCHMARK(BM_ParseDefinition)->Apply(reservedRowArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IndexReserved)->Apply(reservedRowArgs)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadCachedReservedSet)->Apply(reservedRowArgs)->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_Generate)
+	->ArgNames({ "pCount", "contrast", "clamp", "reserved" })
+	->ArgsProduct({ { 1, 1000, 50000, 500000 }, { 1, 4 }, { 256, 128 }, { 13000, 1000000 } })
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_GenerateSharded)
+	->ArgNames({ "pCount", "threads" })
+	->ArgsProduct({ { 50000, 500000 }, { 1, 2, 4, 8 } })
+	->UseRealTime()
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_GenerateSeeded)
+	->ArgNames({ "pCount", "contrast" })
+	->ArgsProduct({ { 1000, 50000, 500000 }, { 1, 4 } })
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_GeneratePerceptual)
+	->ArgNames({ "pCount", "deltaEx10" })
+	->Args({ 1000, 23 })
+	->Args({ 10000, 23 })
+	->Args({ 1000, 100 })
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK(BM_AllocatorThroughput)->ArgName("batch")->Arg(256)->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK(BM_LuminanceSort)->ArgName("pCount")->Arg(1000)->Arg(50000)->Arg(500000)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_WriteColors)
+	->ArgNames({ "pCount", "format" })
+	->ArgsProduct({ { 1000, 50000, 500000 }, { (long)OutputFormat::Text, (long)OutputFormat::Definition, (long)OutputFormat::Json, (long)OutputFormat::Binary } })
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK(BM_WriteImage)
+	->ArgNames({ "pCount", "png" })
+	->ArgsProduct({ { 1000, 50000, 500000 }, { 0, 1 } })
+	->Unit(benchmark::kMicrosecond);
+
+/*
+	ccf_benchmark --write-definition PATH ROWS writes a synthetic definition.csv and exits, for trying the program on large maps.
+	Anything else is passed to Google Benchmark.
+*/
+
+int main(int argc, char *argv[]) {
+
+	setProgressOutput(NULL);
+
+	try {
+
+		if (argc == 4 && std::string(argv[1]) == "--write-definition") {
+			writeSyntheticDefinition(argv[2], std::stoul(argv[3]));
+			return 0;
+		}
+
+		benchmark::Initialize(&argc, argv);
+
+		if (benchmark::ReportUnrecognizedArguments(argc, argv))
+			return 1;
+
+		benchmark::RunSpecifiedBenchmarks();
+		benchmark::Shutdown();
+
+	}
+	catch (const std::exception &e) {
+		std::fprintf(stderr, "%s\n", e.what());
+		removeScratchFiles();
+		return 1;
+	}
+
+	removeScratchFiles();
+
+	return 0;
+
+}
@@ -0,0 +1,65 @@
+#include "synthetic_definition.h"
+#include "generator_f.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+void writeSyntheticDefinition(const std::string &path, unsigned long rows, unsigned int seed) {
+
+	const char *terrain[] = { "land;false;plains;1", "land;false;forest;2", "land;true;hills;3", "sea;false;ocean;0", "lake;false;lakes;7" };
+
+	if (rows >= (unsigned long)COLOR_SPACE_SIZE)
+		throw std::runtime_error("A definition.csv can hold at most " + std::to_string(COLOR_SPACE_SIZE - 1) + " provinces.");
+
+	FILE *file = std::fopen(path.c_str(), "wb");
+
+	if (file == NULL)
+		throw std::runtime_error("Could not write " + path + ".");
+
+	std::fprintf(file, "province;red;green;blue;x;x\n");
+	std::fprintf(file, "0;0;0;0;land;false;unknown;0\n");
+
+	/*An odd multiplier is invertible mod 2^24, so distinct IDs get distinct colors. The ID that lands on black takes the color ID 0 would have had.*/
+
+	const unsigned long mask = COLOR_SPACE_SIZE - 1;
+	const unsigned long multiplier = 0x9E3779B1UL & mask;
+	unsigned long offset = seed & mask;
+
+	for (unsigned long id = 1; id <= rows; id++) {
+
+		Color color = (Color)((id * multiplier + offset) & mask);
+
+		if (color == 0)
+			color = (Color)offset;
+
+		std::fprintf(file, "%lu;%u;%u;%u;%s\n", id, redOf(color), greenOf(color), blueOf(color), terrain[id % 5]);
+
+	}
+
+	bool failed = std::ferror(file) != 0;
+
+	if (std::fclose(file) != 0 || failed)
+		throw std::runtime_error("Could not write " + path + ".");
+
+}
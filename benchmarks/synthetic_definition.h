@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Writes a synthetic definition.csv with `rows` provinces (IDs 1 to rows, plus the usual row 0) to path.
+Colors are spread over the whole RGB cube by an odd multiplier, which maps distinct IDs to distinct colors,
+so any row count up to 16,777,215 gives a valid file. The same seed always gives the same file.
+Throws std::runtime_error if the file cannot be written.
+*/
+
+void writeSyntheticDefinition(const std::string &path, unsigned long rows, unsigned int seed = 0);
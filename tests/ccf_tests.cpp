@@ -0,0 +1,1398 @@
+#include "generator_f.h"
+#include "allocator_f.h"
+#include "cache_f.h"
+#include "color_factory.h"
+#include "server_f.h"
+#include "stream_f.h"
+#include "stats_f.h"
+#include "province_map_f.h"
+#include "region_f.h"
+#include "sources_f.h"
+#include "image_f.h"
+#include "definition_f.h"
+#include "luminance_f.h"
+#include "perceptual_f.h"
+#include "luminance_index_f.h"
+#include "permutation_f.h"
+#include "audit_f.h"
+#include "adjacency_f.h"
+#include "writer_f.h"
+#include "cli_f.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <csignal>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/*
+Author: Derek Warter
+E-mail: derekwarter@gmail.com
+Clausewitz Color Factory
+Deterministically generates unreserved color values for use with the Clausewitz Engine's provincial maps.
+Copyright (C) 2018 Derek Warter
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see https://www.gnu.org/licenses/.
+*/
+
+/*
+Regression tests, run by ctest. Each CCF_TEST registers itself; ccf_tests runs them all, or only those named on the command line,
+and exits non-zero if any CHECK failed. Scratch files go to the temp directory and are removed on exit.
+*/
+
+namespace {
+
+struct TestCase {
+	const char *name;
+	void (*run)();
+};
+
+std::vector<TestCase> &registry() {
+
+	static std::vector<TestCase> tests;
+
+	return tests;
+
+}
+
+bool registerTest(const char *name, void (*run)()) {
+
+	registry().push_back({ name, run });
+
+	return true;
+
+}
+
+std::vector<std::string> scratchFiles;
+
+std::string scratchPath(const std::string &name) {
+
+	std::string path = (std::filesystem::temp_directory_path() / ("ccf_tests_" + name)).string();
+
+	std::remove(path.c_str());
+	scratchFiles.push_back(path);
+
+	return path;
+
+}
+
+/*A reserved set holding the given colors as definition provinces 0, 1, 2...*/
+
+ReservedSet definitionSet(const ColorList &colors) {
+
+	ReservedSet reserved;
+
+	for (Color color : colors)
+		reserved.bitmap.set(color);
+
+	reserved.provinceCount = (unsigned long)colors.size();
+	reserved.maxProvinceId = (long)colors.size() - 1;
+
+	return reserved;
+
+}
+
+/*
+A minimal uncompressed bottom-up BMP. values holds the pixels row by row from the top: colors for 24 and 32 bits, palette indices for 8.
+The palette is written as given, with its size in the header.
+*/
+
+void writeTestBmp(const std::string &path, int bitsPerPixel, int width, int height, const std::vector<uint32_t> &values, const ColorList &palette = ColorList()) {
+
+	size_t stride = (((size_t)width * bitsPerPixel + 31) / 32) * 4;
+	size_t dataOffset = 54 + 4 * palette.size();
+	std::vector<char> file(dataOffset + stride * height, 0);
+
+	auto put = [&](size_t at, uint32_t value, int bytes) {
+		for (int i = 0; i < bytes; i++)
+			file[at + i] = (char)(value >> (8 * i));
+	};
+
+	file[0] = 'B';
+	file[1] = 'M';
+	put(2, (uint32_t)file.size(), 4);
+	put(10, (uint32_t)dataOffset, 4);
+	put(14, 40, 4);
+	put(18, (uint32_t)width, 4);
+	put(22, (uint32_t)height, 4);
+	put(26, 1, 2);
+	put(28, (uint32_t)bitsPerPixel, 2);
+	put(46, (uint32_t)palette.size(), 4);
+
+	for (size_t i = 0; i < palette.size(); i++)
+		put(54 + 4 * i, palette[i], 4);
+
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++)
+			put(dataOffset + (height - 1 - y) * stride + x * bitsPerPixel / 8, values[y * width + x], bitsPerPixel / 8);
+	}
+
+	std::ofstream(path, std::ios::binary).write(file.data(), file.size());
+
+}
+
+/*
+The filtered rows of a PNG written by ImageWriter: IDAT chunks joined, the zlib header skipped and the stored deflate blocks unpacked.
+Empty if a block length does not match its complement or the Adler-32 is wrong.
+*/
+
+std::vector<unsigned char> storedPngRows(const std::string &path, uint32_t &width, uint32_t &height) {
+
+	std::ifstream in(path, std::ios::binary);
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	std::vector<unsigned char> zlib;
+	std::vector<unsigned char> rows;
+
+	auto big32 = [&](const unsigned char *at) {
+		return ((uint32_t)at[0] << 24) | ((uint32_t)at[1] << 16) | ((uint32_t)at[2] << 8) | at[3];
+	};
+
+	for (size_t at = 8; at + 12 <= file.size(); at += 12 + big32(&file[at])) {
+		std::string type(file.begin() + at + 4, file.begin() + at + 8);
+		if (type == "IHDR") {
+			width = big32(&file[at + 8]);
+			height = big32(&file[at + 12]);
+		}
+		if (type == "IDAT")
+			zlib.insert(zlib.end(), file.begin() + at + 8, file.begin() + at + 8 + big32(&file[at]));
+	}
+
+	size_t at = 2;
+
+	for (bool last = false; !last && at + 5 <= zlib.size(); ) {
+		size_t length = zlib[at + 1] | (zlib[at + 2] << 8);
+		if (length != (size_t)(~(zlib[at + 3] | (zlib[at + 4] << 8)) & 0xffff) || at + 5 + length > zlib.size())
+			return std::vector<unsigned char>();
+		last = (zlib[at] & 1) != 0;
+		rows.insert(rows.end(), zlib.begin() + at + 5, zlib.begin() + at + 5 + length);
+		at += 5 + length;
+	}
+
+	uint32_t a = 1;
+	uint32_t b = 0;
+
+	for (unsigned char byte : rows) {
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+
+	if (at + 4 != zlib.size() || big32(&zlib[at]) != ((b << 16) | a))
+		return std::vector<unsigned char>();
+
+	return rows;
+
+}
+
+/*One pass over the clamp box in packed order with a single contrast chain: what every generator must match.*/
+
+ColorList serialContrastChain(const ColorBitmap &reserved, long pCount, short mContrast, const short *clampVals) {
+
+	ColorList values;
+	int lastLuminance = -1;
+
+	for (int r = clampVals[0]; r <= clampVals[3]; r++) {
+		for (int g = clampVals[1]; g <= clampVals[4]; g++) {
+			for (int b = clampVals[2]; b <= clampVals[5] && (long)values.size() < pCount; b++) {
+				Color color = packColor(r, g, b);
+				if (reserved.test(color) || (lastLuminance >= 0 && std::abs(getLuminance(color) - lastLuminance) < mContrast))
+					continue;
+				lastLuminance = getLuminance(color);
+				values.push_back(color);
+			}
+		}
+	}
+
+	return values;
+
+}
+
+ColorList streamAll(const ColorBitmap &reserved, long pCount, short mContrast, const short *clampVals) {
+
+	ColorStream stream(reserved, clampVals, mContrast);
+	ColorList values(pCount);
+	size_t taken = 0;
+
+	/* Odd chunk sizes, so chunk ends fall anywhere relative to rows and red values. */
+
+	while (taken < values.size()) {
+		size_t got = stream.next(values.data() + taken, std::min<size_t>(997, values.size() - taken));
+		if (got == 0)
+			break;
+		taken += got;
+	}
+
+	values.resize(taken);
+
+	return values;
+
+}
+
+/*Whether parseCommandLine throws for these arguments (the program name is added).*/
+
+bool commandLineRejected(std::vector<std::string> arguments) {
+
+	std::vector<char *> argv;
+
+	arguments.insert(arguments.begin(), "ccf_tests");
+
+	for (std::string &argument : arguments)
+		argv.push_back(&argument[0]);
+
+	try {
+		parseCommandLine((int)argv.size(), argv.data());
+	}
+	catch (const std::runtime_error &) {
+		return true;
+	}
+
+	return false;
+
+}
+
+bool contrastHolds(const ColorList &values, short mContrast) {
+
+	for (size_t i = 1; i < values.size(); i++) {
+		if (std::abs(getLuminance(values[i]) - getLuminance(values[i - 1])) < mContrast)
+			return false;
+	}
+
+	return true;
+
+}
+
+}
+
+#define CCF_TEST(name) \
+	static void name(); \
+	static const bool name##Registered = registerTest(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+			throw std::runtime_error(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": CHECK(" #condition ") failed"); \
+	} while (0)
+
+/*
+	Allocation server: release must never free a color the server does not own.
+*/
+
+CCF_TEST(serverRejectsReleaseOfDefinitionColor) {
+
+	Generator generator(definitionSet({ 0x000000 }));
+	AllocationServer server(generator, scratchPath("release.journal"));
+
+	CHECK(server.handleRequest("release 000000").compare(0, 4, "ERR ") == 0);
+	CHECK(generator.isReserved(0x000000));
+
+	std::string reply = server.handleRequest("--count 2");
+
+	CHECK(reply.compare(0, 3, "OK ") == 0);
+	CHECK(reply.find("000000") == std::string::npos);
+
+}
+
+CCF_TEST(serverReleasesOnlyItsOwnColors) {
+
+	std::string journal = scratchPath("own.journal");
+	Generator generator(definitionSet({ 0x000000 }));
+
+	{
+		AllocationServer server(generator, journal);
+
+		CHECK(server.handleRequest("--count 1") == "OK 1 000001");
+		CHECK(server.handleRequest("reserve 000000 000010") == "OK 1");
+		CHECK(server.handleRequest("release 000001 000000").compare(0, 4, "ERR ") == 0);
+		CHECK(generator.isReserved(0x000001));
+	}
+
+	/* After a restart the journal still says which colors the server owns. */
+
+	Generator restarted(definitionSet({ 0x000000 }));
+	AllocationServer server(restarted, journal);
+
+	CHECK(server.handleRequest("release 000001 000010") == "OK");
+	CHECK(!restarted.isReserved(0x000001));
+	CHECK(!restarted.isReserved(0x000010));
+	CHECK(server.handleRequest("release 000001").compare(0, 4, "ERR ") == 0);
+	CHECK(restarted.isReserved(0x000000));
+
+}
+
+CCF_TEST(serverReplayLeavesDefinitionColorsAlone) {
+
+	std::string journal = scratchPath("replay.journal");
+
+	{
+		Generator generator(definitionSet({ 0x000000 }));
+		AllocationServer server(generator, journal);
+
+		CHECK(server.handleRequest("--count 1") == "OK 1 000001");
+	}
+
+	/* The color was added to definition.csv before the restart, so the server no longer owns it. */
+
+	Generator restarted(definitionSet({ 0x000000, 0x000001 }));
+	AllocationServer server(restarted, journal);
+
+	CHECK(server.handleRequest("release 000001").compare(0, 4, "ERR ") == 0);
+	CHECK(restarted.isReserved(0x000001));
+
+}
+
+#ifndef _WIN32
+
+/*Connect to a Unix socket, retrying while the server starts. -1 if it never answers.*/
+
+int connectWhenReady(const std::string &path) {
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	std::copy(path.begin(), path.end(), address.sun_path);
+
+	for (int attempt = 0; attempt < 500; attempt++) {
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0 && connect(fd, (const sockaddr *)&address, sizeof(address)) == 0)
+			return fd;
+		if (fd >= 0)
+			close(fd);
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	return -1;
+
+}
+
+CCF_TEST(serverKeepsServingPastAStalledClient) {
+
+	std::string socketPath = scratchPath("stall.sock");
+	Generator generator((ReservedSet()));
+	AllocationServer server(generator, scratchPath("stall.journal"));
+	std::thread serving([&]() { runServer(socketPath, server); });
+
+	/* The first client sends many requests and never reads a reply, so its socket buffer fills up. */
+
+	int stalled = connectWhenReady(socketPath);
+	std::string flood;
+
+	for (int i = 0; i < 300; i++)
+		flood += "--count 1000\n";
+
+	bool sent = stalled >= 0 && send(stalled, flood.data(), flood.size(), 0) == (ssize_t)flood.size();
+
+	/* A second client must still be answered promptly. */
+
+	int other = connectWhenReady(socketPath);
+	std::string reply;
+
+	if (other >= 0 && send(other, "status\n", 7, 0) == 7) {
+		pollfd ready = { other, POLLIN, 0 };
+		char buffer[256];
+		while ((reply.empty() || reply.back() != '\n') && poll(&ready, 1, 5000) == 1) {
+			ssize_t n = recv(other, buffer, sizeof(buffer), 0);
+			if (n <= 0)
+				break;
+			reply.append(buffer, (size_t)n);
+		}
+	}
+
+	/* Stop the server: the signal interrupts its poll, and a last connection wakes it if the signal came between polls. */
+
+	pthread_kill(serving.native_handle(), SIGINT);
+	int wake = connectWhenReady(socketPath);
+	serving.join();
+
+	for (int fd : { stalled, other, wake }) {
+		if (fd >= 0)
+			close(fd);
+	}
+
+	CHECK(sent);
+	CHECK(reply.compare(0, 3, "OK ") == 0);
+
+}
+
+#endif
+
+/*
+	Contrast across red shards: consecutive colors keep the minimum contrast where one shard ends and the next begins.
+*/
+
+CCF_TEST(contrastHoldsAcrossShardSeams) {
+
+	ColorBitmap reserved;
+	short clamp[6] = { 10, 0, 0, 255, 0, 0 };
+	ColorList expected = serialContrastChain(reserved, 5, 10, clamp);
+
+	CHECK(expected.size() == 5);
+	CHECK(contrastHolds(expected, 10));
+
+	for (unsigned int threads : { 1u, 4u })
+		CHECK(generateShardedValues(reserved, 5, 10, clamp, threads) == expected);
+
+	CHECK(streamAll(reserved, 5, 10, clamp) == expected);
+
+}
+
+CCF_TEST(contrastSeamsMatchSerialPass) {
+
+	ColorBitmap reserved;
+	short clamp[6] = { 0, 0, 0, 255, 255, 255 };
+	short narrow[6] = { 0, 100, 0, 255, 100, 40 };
+
+	for (Color color = 0; color < COLOR_SPACE_SIZE; color += 7)
+		reserved.set(color);
+
+	/* Counts large enough to run through several red values, so there are seams to cross. */
+
+	for (const short *box : { (const short *)clamp, (const short *)narrow }) {
+		for (short contrast : { 2, 5, 40 }) {
+
+			short clampVals[6];
+			std::copy(box, box + 6, clampVals);
+			ColorList expected = serialContrastChain(reserved, box == clamp ? 200000 : COLOR_SPACE_SIZE, contrast, clampVals);
+
+			CHECK(contrastHolds(expected, contrast));
+
+			for (unsigned int threads : { 1u, 3u, 8u })
+				CHECK(generateShardedValues(reserved, (long)expected.size(), contrast, clampVals, threads) == expected);
+
+			CHECK(streamAll(reserved, (long)expected.size(), contrast, clampVals) == expected);
+
+		}
+	}
+
+}
+
+/*
+	Generator: a request that fails leaves the allocator as it was.
+*/
+
+CCF_TEST(failedRequestKeepsAllocatorState) {
+
+	Generator generator((ReservedSet()));
+	GenerateOptions options;
+	short clamp[6] = { 0, 0, 0, 0, 0, 9 };
+	bool failed = false;
+
+	std::copy(clamp, clamp + 6, options.clampVals);
+
+	try {
+		generator.generate(20, options);
+	}
+	catch (const std::runtime_error &e) {
+		failed = std::string(e.what()).find("Only 10 ") != std::string::npos;
+	}
+
+	CHECK(failed);
+	CHECK(generator.available(options) == 10);
+	CHECK(generator.generate(5, options) == ColorList({ 0, 1, 2, 3, 4 }));
+	CHECK(generator.generate(5, options) == ColorList({ 5, 6, 7, 8, 9 }));
+	CHECK(generator.available(options) == 0);
+
+}
+
+/*
+	Lock-free allocator: every free color goes to exactly one thread, and reserved colors never come free.
+*/
+
+CCF_TEST(allocatorHandsOutEachColorOnce) {
+
+	ReservedSet reserved = definitionSet({ 0x000000, 0x012345, 0x0fffff });
+	short clamp[6] = { 0, 0, 0, 15, 255, 255 };
+	ColorAllocator allocator(reserved.bitmap, clamp);
+	unsigned long expected = allocator.available();
+	std::vector<ColorList> handedOut(4);
+	std::vector<std::thread> threads;
+
+	for (unsigned int worker = 0; worker < handedOut.size(); worker++) {
+		threads.emplace_back([&, worker]() {
+			ColorAllocator::Cursor cursor = allocator.cursor(worker, (unsigned int)handedOut.size());
+			Color chunk[1000];
+			for (size_t n; (n = allocator.allocate(cursor, chunk, 1000)) != 0; )
+				handedOut[worker].insert(handedOut[worker].end(), chunk, chunk + n);
+		});
+	}
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	ColorList all;
+
+	for (const ColorList &values : handedOut)
+		all.insert(all.end(), values.begin(), values.end());
+
+	std::sort(all.begin(), all.end());
+
+	CHECK(expected == 16 * 65536 - 3);
+	CHECK(all.size() == expected);
+	CHECK(std::adjacent_find(all.begin(), all.end()) == all.end());
+	CHECK(all.back() <= 0x0fffff);
+	CHECK(std::none_of(all.begin(), all.end(), [&](Color color) { return reserved.bitmap.test(color); }));
+	CHECK(allocator.available() == 0);
+
+}
+
+CCF_TEST(allocatorReleaseKeepsFixedColors) {
+
+	short clamp[6] = { 0, 0, 0, 0, 0, 9 };
+	ColorAllocator allocator(definitionSet({ 0x000005 }).bitmap, clamp);
+	ColorAllocator::Cursor cursor = allocator.cursor();
+	Color color = 0;
+
+	allocator.release(0x000005);
+	allocator.release(0x000100);
+
+	CHECK(allocator.isTaken(0x000005));
+	CHECK(allocator.isTaken(0x000100));
+	CHECK(allocator.available() == 9);
+	CHECK(!allocator.claim(0x000005));
+
+	CHECK(allocator.allocate(cursor, color) && color == 0x000000);
+	allocator.release(color);
+	CHECK(allocator.available() == 9);
+
+	Color all[16];
+
+	CHECK(allocator.allocate(cursor, all, 16) == 9);
+	CHECK(std::find(all, all + 9, (Color)0x000005) == all + 9);
+
+}
+
+/*
+	Province maps: every supported depth reads the same colors, and malformed maps are refused.
+*/
+
+CCF_TEST(provinceMapReadsEveryDepth) {
+
+	std::vector<uint32_t> colors = { 0x102030, 0x102030, 0x405060, 0xa0b0c0, 0x405060, 0x000001 };
+	std::vector<uint32_t> indices = { 0, 0, 1, 2, 1, 3 };
+	ColorList palette = { 0x102030, 0x405060, 0xa0b0c0, 0x000001 };
+
+	for (int bits : { 8, 24, 32 }) {
+
+		std::string path = scratchPath("map" + std::to_string(bits) + ".bmp");
+		writeTestBmp(path, bits, 3, 2, bits == 8 ? indices : colors, bits == 8 ? palette : ColorList());
+
+		ProvinceMapScan scan = scanProvinceMap(path);
+
+		CHECK(scan.width == 3 && scan.height == 2);
+		CHECK(scan.colorCount == 4);
+		CHECK(std::all_of(palette.begin(), palette.end(), [&](Color color) { return scan.colors.test(color); }));
+
+		/* Rows come in file order, so the bottom row of the image first. */
+
+		ProvinceMapReader reader(path);
+		const Color *row = reader.nextRow();
+
+		CHECK(row != NULL && ColorList(row, row + 3) == ColorList({ 0xa0b0c0, 0x405060, 0x000001 }));
+		row = reader.nextRow();
+		CHECK(row != NULL && ColorList(row, row + 3) == ColorList({ 0x102030, 0x102030, 0x405060 }));
+		CHECK(reader.nextRow() == NULL);
+
+	}
+
+}
+
+CCF_TEST(provinceMapRejectsIndexPastPalette) {
+
+	std::string path = scratchPath("short_palette.bmp");
+	std::vector<std::string> messages;
+
+	writeTestBmp(path, 8, 3, 1, { 0, 1, 5 }, { 0x102030, 0x405060 });
+
+	std::vector<std::function<void()>> readers = {
+		[&]() { scanProvinceMap(path); },
+		[&]() { ProvinceMapReader reader(path); while (reader.nextRow() != NULL); },
+		[&]() { recolorProvinceMap(path, scratchPath("short_palette_out.bmp"), [](Color color) { return color; }); },
+	};
+
+	for (const std::function<void()> &read : readers) {
+		try {
+			read();
+			messages.push_back("");
+		}
+		catch (const std::runtime_error &e) {
+			messages.push_back(e.what());
+		}
+	}
+
+	for (const std::string &message : messages)
+		CHECK(message.find("palette entry 5") != std::string::npos);
+
+}
+
+/*
+	Regions: terms combine as sets, and a term compiled from several threads, evicted and read back from disk is always the same bitmap.
+*/
+
+CCF_TEST(regionTermsCombineAsSets) {
+
+	CHECK(compileRegion("rgb:0-10,0-10,0-10").count() == 11 * 11 * 11);
+	CHECK(compileRegion("rgb:0-10,0-10,0-10&rgb:5-20,5-20,5-20").count() == 6 * 6 * 6);
+
+	ColorBitmap reserved = constrainReserved(definitionSet({ 0x000002 }).bitmap, { "rgb:0-0,0-0,0-9" }, { "rgb:0-0,0-0,0-4" });
+
+	CHECK(COLOR_SPACE_SIZE - reserved.count() == 5);
+	CHECK(!reserved.test(0x000005) && !reserved.test(0x000009));
+	CHECK(reserved.test(0x000002) && reserved.test(0x00000a));
+
+}
+
+CCF_TEST(regionCacheSurvivesThreadsAndEviction) {
+
+	std::string directory = scratchPath("regions");
+	std::filesystem::create_directory(directory);
+	setRegionCacheDirectory(directory);
+
+	std::vector<ColorBitmap> results(4);
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < results.size(); i++)
+		threads.emplace_back([&, i]() { results[i] = compileRegion("chroma:0-3"); });
+
+	for (std::thread &thread : threads)
+		thread.join();
+
+	size_t cacheFiles = 0;
+
+	for (const auto &entry : std::filesystem::directory_iterator(directory))
+		cacheFiles += entry.path().extension() == ".bits";
+
+	/* Push the term out of memory, so the next compile reads it from disk. */
+
+	for (int i = 0; i < 20; i++)
+		compileRegion("rgb:" + std::to_string(i) + "-" + std::to_string(i) + ",0-255,0-255");
+
+	ColorBitmap reloaded = compileRegion("chroma:0-3");
+
+	setRegionCacheDirectory("");
+	std::filesystem::remove_all(directory);
+
+	CHECK(results[0].count() > 0 && results[0].test(0x808080) && !results[0].test(0xff0000));
+
+	for (const ColorBitmap &result : results)
+		CHECK(result.words == results[0].words);
+
+	CHECK(cacheFiles == 1);
+	CHECK(reloaded.words == results[0].words);
+
+}
+
+/*
+	Several definition files: the merge reserves every color of every file, and the report names the files sharing a color.
+*/
+
+CCF_TEST(sourcesMergeAndReportCollisions) {
+
+	std::string base = scratchPath("base.csv");
+	std::string mod = scratchPath("mod.csv");
+	std::string report = scratchPath("collisions.txt");
+
+	std::ofstream(base) << "province;red;green;blue;x;x;x;x\n1;1;2;3;land;false;plains;1\n2;4;5;6;land;false;plains;1\n";
+	std::ofstream(mod) << "province;red;green;blue;x;x;x;x\n9;4;5;6;land;false;plains;1\n10;7;8;9;land;false;plains;1\n";
+
+	std::vector<ReservedSource> sources = loadReservedSources({ base, mod }, false);
+	ReservedSet merged = mergeReservedSources(sources);
+
+	CHECK(merged.provinceCount == 3);
+	CHECK(merged.maxProvinceId == 10);
+	CHECK(merged.bitmap.test(0x010203) && merged.bitmap.test(0x040506) && merged.bitmap.test(0x070809));
+	CHECK(countCollisions(sources) == 1);
+
+	std::vector<ColorCollision> collisions = findCollisions(sources);
+
+	CHECK(collisions.size() == 1 && collisions[0].color == 0x040506);
+	CHECK(collisions[0].owners == std::vector<size_t>({ 0, 1 }));
+
+	writeCollisionReport(report, sources, collisions);
+	std::ifstream written(report);
+	std::string line;
+
+	CHECK(std::getline(written, line) && line == "(4, 5, 6) 040506: " + base + ", " + mod);
+
+	/* One file never collides with itself: the report is written, empty. */
+
+	sources.pop_back();
+	writeCollisionReport(report, sources, findCollisions(sources));
+
+	CHECK(findCollisions(sources).empty());
+	CHECK(std::filesystem::file_size(report) == 0);
+
+}
+
+/*
+	Preview images: both writers read back as the colors written, row-major from the top-left, padded with white.
+*/
+
+CCF_TEST(imageWritersReadBack) {
+
+	ColorList colors = { 0x102030, 0x405060, 0x708090, 0xa0b0c0, 0xd0e0f0 };
+	std::string bmp = scratchPath("preview.bmp");
+	std::string png = scratchPath("preview.png");
+
+	writeImage(colors, bmp, 3);
+	writeImage(colors, png, 3);
+
+	ProvinceMapReader reader(bmp);
+	const Color *row = reader.nextRow();
+
+	CHECK(reader.width() == 3 && reader.height() == 2);
+	CHECK(row != NULL && ColorList(row, row + 3) == ColorList({ 0x102030, 0x405060, 0x708090 }));
+	row = reader.nextRow();
+	CHECK(row != NULL && ColorList(row, row + 3) == ColorList({ 0xa0b0c0, 0xd0e0f0, 0xffffff }));
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<unsigned char> rows = storedPngRows(png, width, height);
+
+	CHECK(width == 3 && height == 2);
+	CHECK(rows == std::vector<unsigned char>({
+		0, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0x90,
+		0, 0xa0, 0xb0, 0xc0, 0xd0, 0xe0, 0xf0, 0xff, 0xff, 0xff }));
+
+}
+
+#ifndef _WIN32
+
+/*The BMP is written front to back, so a pipe works as the output.*/
+
+CCF_TEST(bmpWriterStreamsToAPipe) {
+
+	std::string fifo = scratchPath("preview.fifo");
+	std::vector<char> received;
+
+	CHECK(mkfifo(fifo.c_str(), 0600) == 0);
+
+	std::thread reading([&]() {
+		std::ifstream in(fifo, std::ios::binary);
+		received.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	});
+
+	std::string message;
+
+	try {
+		writeImage(ColorList(1000, 0x123456), fifo, 40);
+	}
+	catch (const std::runtime_error &e) {
+		message = e.what();
+	}
+
+	reading.join();
+
+	CHECK(message.empty());
+	CHECK(received.size() == 54 + 25 * 120);
+	CHECK(received.size() > 57 && (unsigned char)received[54] == 0x56 && (unsigned char)received[56] == 0x12);
+
+}
+
+/*A failed write is reported, and the white padding the destructor adds afterwards stays inside the row buffer.*/
+
+CCF_TEST(imageWriterReportsFullDisk) {
+
+	if (!std::filesystem::exists("/dev/full"))
+		return;
+
+	std::string message;
+
+	try {
+		writeImage(ColorList(100000, 0x123456), "/dev/full", 400);
+	}
+	catch (const std::runtime_error &e) {
+		message = e.what();
+	}
+
+	CHECK(message == "Could not write to /dev/full.");
+
+}
+
+#endif
+
+/*
+	Definition parsing: the mapped parser skips what the game skips and points at the line of a bad row.
+*/
+
+CCF_TEST(definitionParserReadsMappedFile) {
+
+	std::string csv = scratchPath("parse.csv");
+	long maxProvinceId = 0;
+
+	std::ofstream(csv, std::ios::binary) << "\xEF\xBB\xBFprovince;red;green;blue;x;y\r\n1;1;2;3;land;false;plains;1\r\n\n# comment\n 40 ; 255;0;16;sea\n7;4;5;6";
+
+	CHECK(getReservedList(csv, &maxProvinceId) == ColorList({ 0x010203, 0xff0010, 0x040506 }));
+	CHECK(maxProvinceId == 40);
+
+	std::string empty = scratchPath("empty.csv");
+	std::ofstream(empty, std::ios::binary);
+	CHECK(getReservedList(empty).empty());
+
+	std::vector<std::pair<std::string, std::string>> broken = {
+		{ "1;1;2;3\n2;1;2\n", "line 2: too few fields" },
+		{ "1;1;2;3\n\n2;1;x;3\n", "line 3: expected a number" },
+		{ "1;1;2;300\n", "line 1: color value 300 is outside 0-255" },
+	};
+
+	for (const std::pair<std::string, std::string> &entry : broken) {
+
+		std::string message;
+		std::ofstream(csv, std::ios::binary) << entry.first;
+
+		try {
+			getReservedList(csv);
+		}
+		catch (const std::runtime_error &e) {
+			message = e.what();
+		}
+
+		CHECK(message.find(entry.second) != std::string::npos);
+
+	}
+
+}
+
+/*
+	Luminance kernel: the vector kernel must agree with getLuminance for every color, including ragged block tails.
+*/
+
+CCF_TEST(batchLuminanceMatchesScalar) {
+
+	ColorList colors(COLOR_SPACE_SIZE);
+	std::vector<unsigned char> luminance(COLOR_SPACE_SIZE + 1);
+
+	for (size_t i = 0; i < colors.size(); i++)
+		colors[i] = (Color)i;
+
+	/* Odd block sizes, so every kernel ends on a partial vector. */
+
+	for (size_t start = 0; start < colors.size(); start += 4099)
+		batchLuminance(colors.data() + start, std::min<size_t>(4099, colors.size() - start), luminance.data() + start);
+
+	size_t mismatches = 0;
+
+	for (size_t i = 0; i < colors.size(); i++)
+		mismatches += luminance[i] != getLuminance(colors[i]);
+
+	CHECK(mismatches == 0);
+
+	luminance[COLOR_SPACE_SIZE] = 0x5a;
+	batchLuminance(colors.data() + COLOR_SPACE_SIZE - 3, 3, luminance.data() + COLOR_SPACE_SIZE - 3);
+
+	CHECK(luminance[COLOR_SPACE_SIZE] == 0x5a);
+	CHECK(luminance[COLOR_SPACE_SIZE - 1] == 255);
+
+}
+
+/*
+	Delta E mode: every pair of colors, not just neighbours in the list, is at least the minimum apart.
+*/
+
+CCF_TEST(perceptualValuesKeepEveryPairApart) {
+
+	ReservedSet reserved = definitionSet({ 0x000000, 0xffffff, 0x808080 });
+	short clamp[6] = { 0, 0, 0, 255, 255, 255 };
+	ColorList values = generatePerceptualValues(reserved.bitmap, 300, 12.0, clamp);
+	double closest = 1e9;
+
+	for (size_t i = 0; i < values.size(); i++) {
+		for (size_t j = i + 1; j < values.size(); j++)
+			closest = std::min(closest, deltaE(toLab(values[i]), toLab(values[j])));
+	}
+
+	CHECK(values.size() == 300);
+	CHECK(closest >= 12.0);
+	CHECK(std::none_of(values.begin(), values.end(), [&](Color color) { return reserved.bitmap.test(color); }));
+
+}
+
+CCF_TEST(labGridMatchesBruteForce) {
+
+	LabGrid grid(7.5);
+	std::vector<LabColor> accepted;
+
+	for (Color color = 0; color < COLOR_SPACE_SIZE; color += 7919) {
+
+		LabColor lab = toLab(color);
+		bool separated = std::all_of(accepted.begin(), accepted.end(), [&](const LabColor &other) { return deltaE(lab, other) >= 7.5; });
+
+		CHECK(grid.isSeparated(lab) == separated);
+
+		if (separated) {
+			grid.insert(lab);
+			accepted.push_back(lab);
+		}
+
+	}
+
+	CHECK(accepted.size() > 100);
+
+}
+
+/*
+	Luminance index: band counts and takes agree with a scan of the clamp box.
+*/
+
+CCF_TEST(luminanceIndexAnswersBands) {
+
+	ReservedSet reserved = definitionSet({ 0x0a0000, 0x0b1020, 0x1e1e1e });
+	short clamp[6] = { 10, 0, 0, 30, 255, 255 };
+	LuminanceIndex index(reserved.bitmap, clamp);
+	unsigned long inBand = 0;
+	unsigned long total = 0;
+
+	for (int r = clamp[0]; r <= clamp[3]; r++) {
+		for (int g = clamp[1]; g <= clamp[4]; g++) {
+			for (int b = clamp[2]; b <= clamp[5]; b++) {
+				Color color = packColor(r, g, b);
+				if (reserved.bitmap.test(color))
+					continue;
+				total++;
+				inBand += getLuminance(color) >= 40 && getLuminance(color) <= 90;
+			}
+		}
+	}
+
+	CHECK(index.size() == total);
+	CHECK(index.count(0, 255) == total);
+	CHECK(index.count(40, 90) == inBand);
+
+	ColorList band = index.take(40, 90, 5000);
+
+	CHECK(band.size() == 5000);
+	CHECK(getLuminance(band.front()) == 40);
+	CHECK(std::is_sorted(band.begin(), band.end(), [](Color a, Color b) { return getLuminance(a) < getLuminance(b); }));
+
+	/* Colors reserved after the index was built are skipped through exclude. */
+
+	ColorBitmap exclude = reserved.bitmap;
+	exclude.set(band[0]);
+
+	CHECK(index.count(40, 90, exclude) == inBand - 1);
+	CHECK(index.take(40, 90, 1, 1, &exclude)[0] == band[1]);
+
+	ColorList spaced = index.take(40, 90, 100, 10);
+
+	CHECK(spaced.size() == 6);
+
+	for (size_t i = 1; i < spaced.size(); i++)
+		CHECK(getLuminance(spaced[i]) - getLuminance(spaced[i - 1]) >= 10);
+
+}
+
+/*
+	Streaming: the stream's first n colors are generateUnreservedValues(n), and it runs dry exactly at the box's free colors.
+*/
+
+CCF_TEST(streamMatchesGeneratedList) {
+
+	ColorBitmap reserved;
+
+	for (Color color = 0; color < COLOR_SPACE_SIZE; color += 13)
+		reserved.set(color);
+
+	short clamp[6] = { 3, 7, 0, 40, 200, 255 };
+
+	for (short contrast : { 1, 5 }) {
+		ColorList expected = generateUnreservedValues(reserved, 40000, contrast, clamp);
+		CHECK(expected.size() == 40000);
+		CHECK(streamAll(reserved, 40000, contrast, clamp) == expected);
+	}
+
+	short small[6] = { 0, 0, 0, 1, 20, 255 };
+	unsigned long free = countFreeColors(reserved, small);
+	ColorList all = streamAll(reserved, (long)free + 10, 1, small);
+
+	CHECK(all.size() == free);
+	CHECK(std::is_sorted(all.begin(), all.end()));
+	CHECK(std::none_of(all.begin(), all.end(), [&](Color color) { return reserved.test(color); }));
+
+}
+
+/*
+	Seeded order: a bijection over the clamp box, fixed by the seed, and a longer run starts with a shorter one.
+*/
+
+CCF_TEST(permutationIsBijectionOverBox) {
+
+	short box[6] = { 10, 20, 30, 40, 60, 90 };
+	short full[6] = { 0, 0, 0, 255, 255, 255 };
+
+	for (const short *clamp : { (const short *)box, (const short *)full }) {
+
+		ColorPermutation permutation(clamp, 12345);
+		ColorBitmap seen;
+		bool insideBox = true;
+
+		CHECK(permutation.size() == (uint32_t)(clamp[3] - clamp[0] + 1) * (clamp[4] - clamp[1] + 1) * (clamp[5] - clamp[2] + 1));
+
+		for (uint32_t i = 0; i < permutation.size(); i++) {
+			Color color = permutation.at(i);
+			insideBox = insideBox && redOf(color) >= clamp[0] && redOf(color) <= clamp[3] && greenOf(color) >= clamp[1] && greenOf(color) <= clamp[4]
+				&& blueOf(color) >= clamp[2] && blueOf(color) <= clamp[5];
+			seen.set(color);
+		}
+
+		CHECK(insideBox);
+		CHECK(seen.count() == permutation.size());
+
+	}
+
+	CHECK(ColorPermutation(box, 1).at(0) == ColorPermutation(box, 1).at(0));
+	CHECK(ColorPermutation(box, 1).at(0) != ColorPermutation(box, 2).at(0) || ColorPermutation(box, 1).at(1) != ColorPermutation(box, 2).at(1));
+
+}
+
+CCF_TEST(seededValuesExtendShorterRuns) {
+
+	ReservedSet reserved = definitionSet({ 0x0a141e, 0x102030 });
+	short clamp[6] = { 10, 20, 30, 40, 60, 90 };
+
+	for (short contrast : { 1, 8 }) {
+
+		ColorList shorter = generateSeededValues(reserved.bitmap, 500, contrast, clamp, 99);
+		ColorList longer = generateSeededValues(reserved.bitmap, 2000, contrast, clamp, 99);
+
+		CHECK(shorter.size() == 500 && longer.size() == 2000);
+		CHECK(std::equal(shorter.begin(), shorter.end(), longer.begin()));
+		CHECK(std::none_of(longer.begin(), longer.end(), [&](Color color) { return reserved.bitmap.test(color); }));
+		CHECK(contrast == 1 || contrastHolds(longer, contrast));
+
+	}
+
+}
+
+/*
+	Audit and repair: every fixable problem is found, and the repaired copy audits clean.
+*/
+
+CCF_TEST(repairedDefinitionAuditsClean) {
+
+	std::string csv = scratchPath("audit.csv");
+	std::string repaired = scratchPath("audit_fixed.csv");
+
+	std::ofstream(csv, std::ios::binary) << "province;red;green;blue;x;x;x;x\n"
+		"1;10;10;10;land;false;plains;1\n"
+		"2;20;20;20;land;false;plains;1\n"
+		"2;30;30;30;sea;true;ocean;0\n"
+		"-5;40;40;40;land;false;hills;2\n"
+		"5;10;10;10;land;false;forest;3\n"
+		"6;50;300;50;lake;false;lakes;0\n";
+
+	DefinitionAudit audit = auditDefinition(csv, 3);
+
+	CHECK(!audit.clean());
+	CHECK(audit.duplicateColors.size() == 1 && audit.rows[audit.duplicateColors[0]].line == 6);
+	CHECK(audit.badChannels.size() == 1 && audit.rows[audit.badChannels[0]].line == 7);
+	CHECK(audit.duplicateIds.size() == 1 && audit.rows[audit.duplicateIds[0]].line == 4);
+	CHECK(audit.negativeIds.size() == 1);
+	CHECK(audit.missingIdCount() == 2);
+	CHECK(audit.colorsToReplace() == 2);
+
+	short clamp[6] = { 0, 0, 0, 255, 255, 255 };
+	ColorList fresh = generateUnreservedValues(audit.colors, (long)audit.colorsToReplace(), 1, clamp);
+
+	repairDefinition(csv, audit, fresh, repaired);
+
+	DefinitionAudit again = auditDefinition(repaired, 3);
+
+	CHECK(again.clean());
+	CHECK(again.rows.size() == audit.rows.size());
+	CHECK(again.colors.test(fresh[0]) && again.colors.test(fresh[1]));
+
+	/* Reused and negative IDs fill the gaps, and the rest of each line is copied unchanged. */
+
+	std::ifstream in(repaired);
+	std::string line;
+	std::vector<std::string> lines;
+
+	while (std::getline(in, line))
+		lines.push_back(line);
+
+	CHECK(lines.size() == 7 && lines[0] == "province;red;green;blue;x;x;x;x");
+	CHECK(lines[3] == "3;30;30;30;sea;true;ocean;0");
+	CHECK(lines[4] == "4;40;40;40;land;false;hills;2");
+	CHECK(lines[6].find(";lake;false;lakes;0") != std::string::npos);
+
+}
+
+/*
+	Adjacency coloring: no two bordering provinces share a color, and the recolored map carries exactly the assigned colors.
+*/
+
+CCF_TEST(adjacentProvincesNeverShareColor) {
+
+	/* An 8 x 6 grid of 5-pixel provinces, every third one already defined. */
+
+	const int columns = 8;
+	const int rows = 6;
+	const int cell = 5;
+	std::string path = scratchPath("grid.bmp");
+	std::string recoloredPath = scratchPath("grid_new.bmp");
+	std::vector<uint32_t> pixels(columns * cell * rows * cell);
+	ColorBitmap defined;
+
+	for (int y = 0; y < rows * cell; y++) {
+		for (int x = 0; x < columns * cell; x++) {
+			int province = (y / cell) * columns + x / cell;
+			pixels[y * columns * cell + x] = packColor(province + 1, 0, 0);
+			if (province % 3 == 0)
+				defined.set(packColor(province + 1, 0, 0));
+		}
+	}
+
+	writeTestBmp(path, 24, columns * cell, rows * cell, pixels);
+
+	ProvinceGraph graph = buildProvinceGraph(path);
+	ColorBitmap reserved = defined;
+	short clamp[6] = { 0, 0, 0, 255, 255, 255 };
+
+	reserved.merge(scanProvinceMap(path).colors);
+
+	CHECK(graph.colors.size() == columns * rows);
+	CHECK(graph.edgeCount() == (columns - 1) * rows + columns * (rows - 1));
+
+	ProvinceColoring coloring = colorProvinces(graph, defined, reserved, clamp, 7, 4);
+
+	CHECK(coloring.recolored.size() == columns * rows - (columns * rows + 2) / 3);
+	CHECK(coloring.colors == colorProvinces(graph, defined, reserved, clamp, 7, 1).colors);
+	CHECK(coloring.minNeighbourDeltaE > 0);
+
+	for (size_t v = 0; v < graph.colors.size(); v++) {
+		CHECK(defined.test(graph.colors[v]) ? coloring.colors[v] == graph.colors[v] : !reserved.test(coloring.colors[v]));
+		for (uint32_t i = graph.offsets[v]; i < graph.offsets[v + 1]; i++)
+			CHECK(coloring.colors[v] != coloring.colors[graph.neighbours[i]]);
+	}
+
+	recolorProvinceMap(path, recoloredPath, [&](Color color) { return coloring.colors[graph.indexOf(color)]; });
+
+	ProvinceMapReader original(path);
+	ProvinceMapReader recolored(recoloredPath);
+
+	for (const Color *before; (before = original.nextRow()) != NULL; ) {
+		const Color *after = recolored.nextRow();
+		CHECK(after != NULL);
+		for (int x = 0; x < original.width(); x++)
+			CHECK(after[x] == coloring.colors[graph.indexOf(before[x])]);
+	}
+
+}
+
+/*
+	Definition cache: a cached or appended load must equal a fresh parse.
+*/
+
+CCF_TEST(cacheFollowsAppendedRows) {
+
+	std::string csv = scratchPath("cached.csv");
+	std::string cache = scratchPath("cached.csv.cache");
+	std::string stale = scratchPath("cached.csv.cache.tmp");
+
+	/* A leftover entry with the old fixed temporary name must not stop the cache from being written. */
+
+	std::filesystem::create_directory(stale);
+	std::ofstream(csv, std::ios::binary) << "province;red;green;blue;x;x;x;x\n1;10;20;30;land;false;plains;1\n";
+
+	ReservedSet parsed = loadReservedSet(csv);
+
+	CHECK(parsed.cacheStatus == "parsed");
+	CHECK(std::filesystem::is_regular_file(cache));
+
+	ReservedSet cached = loadReservedSet(csv);
+
+	CHECK(cached.cacheStatus == "cached");
+	CHECK(cached.bitmap.test(0x0a141e));
+	CHECK(cached.provinceCount == 1);
+	CHECK(cached.maxProvinceId == 1);
+
+	std::ofstream(csv, std::ios::binary | std::ios::app) << "7;40;50;60;land;false;plains;1\n";
+
+	ReservedSet appended = loadReservedSet(csv);
+	ReservedSet fresh = loadReservedSet(csv, false);
+
+	CHECK(appended.cacheStatus == "appended");
+	CHECK(appended.bitmap.words == fresh.bitmap.words);
+	CHECK(appended.provinceCount == 2);
+	CHECK(appended.maxProvinceId == 7);
+	CHECK(loadReservedSet(csv).cacheStatus == "cached");
+
+	std::vector<char> header(8);
+	std::ifstream(cache, std::ios::binary).read(header.data(), 8);
+
+	CHECK(std::string(header.begin(), header.end()) == "CCFRSV02");
+	CHECK(std::filesystem::file_size(cache) == 64 + COLOR_SPACE_SIZE / 8);
+
+}
+
+/*
+	Instrumentation: a long-running process records stages without growing.
+*/
+
+CCF_TEST(stageTableStaysBounded) {
+
+	for (int i = 0; i < 20000; i++)
+		recordStage("repeated stage", 0, 0.001 * (i % 7));
+
+	for (int i = 0; i < 200; i++)
+		recordStage("stage " + std::to_string(i), 0, 0.001);
+
+	std::ostringstream report;
+	printStats(report);
+	std::string text = report.str();
+	size_t lines = std::count(text.begin(), text.end(), '\n');
+
+	CHECK(text.find("repeated stage") != std::string::npos);
+	CHECK(text.find("(20000 runs, longest 6.000 ms)") != std::string::npos);
+	CHECK(text.find("  other ") != std::string::npos);
+	CHECK(lines < 80);
+
+	std::string trace = scratchPath("trace.json");
+	writeTrace(trace);
+	std::ifstream in(trace);
+	std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	CHECK(std::count(json.begin(), json.end(), '\n') <= 10003);
+	CHECK(json.find("\"dropped_events\":") != std::string::npos);
+
+}
+
+/*
+	Writer: definition fields of any accepted length fit the buffer, and longer ones are refused.
+*/
+
+CCF_TEST(writerHandlesLongDefinitionFields) {
+
+	std::string path = scratchPath("fields.csv");
+	std::string fields(MAX_DEFINITION_FIELDS_LENGTH, 'x');
+	ColorList colors(2000, 0x0a0b0c);
+
+	{
+		ColorWriter writer(path, OutputFormat::Definition, 1, fields);
+		writer.write(colors.data(), colors.size());
+		writer.finish();
+	}
+
+	std::ifstream in(path);
+	size_t rows = 0;
+
+	for (std::string line; std::getline(in, line); rows++)
+		CHECK(line == std::to_string(rows + 1) + ";10;11;12;" + fields);
+
+	CHECK(rows == colors.size());
+
+	bool refused = false;
+
+	try {
+		ColorWriter writer(path, OutputFormat::Definition, 1, fields + "x");
+	}
+	catch (const std::runtime_error &) {
+		refused = true;
+	}
+
+	CHECK(refused);
+
+}
+
+/*
+	Command line: job flags are validated in every mode that takes them, and on every batch line.
+*/
+
+CCF_TEST(everyModeValidatesJobFlags) {
+
+	const std::vector<std::string> badClamp = { "--clamp", "10", "0", "0", "5", "255", "255" };
+	const std::vector<std::vector<std::string>> modes = {
+		{ "--count", "5" },
+		{ "--audit", "definition.csv", "--repair", "fixed.csv" },
+		{ "--serve", "ccf.sock" },
+		{ "--batch", "jobs.txt" },
+		{ "--province-map", "provinces.bmp", "--color-provinces", "out.bmp" },
+	};
+
+	for (const std::vector<std::string> &mode : modes) {
+		std::vector<std::string> arguments = mode;
+		CHECK(!commandLineRejected(arguments));
+		arguments.insert(arguments.end(), badClamp.begin(), badClamp.end());
+		CHECK(commandLineRejected(arguments));
+	}
+
+	std::string batch = scratchPath("jobs.txt");
+	std::ofstream(batch) << "--count 5\n# comment\n--count 5 --clamp 10 0 0 5 255 255\n";
+	std::string message;
+
+	try {
+		readBatchFile(batch, GenerationJob());
+	}
+	catch (const std::runtime_error &e) {
+		message = e.what();
+	}
+
+	CHECK(message.find("line 3: Minimum clamp values") != std::string::npos);
+
+}
+
+int main(int argc, char *argv[]) {
+
+	int failures = 0;
+	int run = 0;
+
+	setProgressOutput(NULL);
+
+	for (const TestCase &test : registry()) {
+
+		bool selected = argc < 2;
+
+		for (int i = 1; i < argc; i++)
+			selected = selected || test.name == std::string(argv[i]);
+
+		if (!selected)
+			continue;
+
+		run++;
+
+		try {
+			test.run();
+			std::cout << "PASS " << test.name << std::endl;
+		}
+		catch (const std::exception &e) {
+			std::cout << "FAIL " << test.name << ": " << e.what() << std::endl;
+			failures++;
+		}
+
+	}
+
+	for (const std::string &path : scratchFiles)
+		std::remove(path.c_str());
+
+	std::cout << run - failures << " of " << run << " tests passed." << std::endl;
+
+	return failures == 0 ? 0 : 1;
+
+}